@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <string>
 #include <vector>
 #include "vulkan/VulkanEngine.hpp"
 #include "Assets/SceneTypes.hpp"
@@ -26,6 +27,26 @@ namespace Assets {
 		Float3 mV[3];
 	};
 
+	// RGBA8 texels of one glTF image, decoded on the CPU.
+	struct DecodedImage {
+		std::string name;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> pixels;
+		size_t encodedBytes = 0;
+		double decodeMilliseconds = 0.0;
+	};
+
+	struct ImageDecodeStats {
+		size_t imageCount = 0;
+		size_t encodedBytes = 0;
+		size_t decodedBytes = 0;
+		double wallMilliseconds = 0.0;
+		double minImageMilliseconds = 0.0;
+		double maxImageMilliseconds = 0.0;
+		double totalImageMilliseconds = 0.0;
+	};
+
 	/**
 	 * @brief GltfModel class handles loading, parsing, and basic CPU-side
 	 * processing of glTF/GLB models. It extracts vertex data and scene graph
@@ -35,6 +56,7 @@ namespace Assets {
 	class GltfModel {
 	public:
 		GltfModel();
+		explicit GltfModel(std::filesystem::path filepath);
 		~GltfModel();
 
 		GltfModel(const GltfModel&) = delete;
@@ -48,7 +70,13 @@ namespace Assets {
 		 */
 		bool Load(int const sceneID);
 
-		void createTextureImage();
+		/**
+		 * @brief Decodes every image referenced by the asset (embedded GLB buffer views,
+		 * data URIs or external files) in parallel on the given job system. Images that
+		 * cannot be read or decoded are logged and left empty.
+		 * @return Aggregate throughput and per-image latency of the decode.
+		 */
+		ImageDecodeStats DecodeImages(JobSystem& jobs);
 
 		// Public accessors for the loaded CPU-side data.
 		const std::vector<Vertex>& GetVertices() const { return m_Vertices; }
@@ -56,6 +84,7 @@ namespace Assets {
 		const std::vector<Triangle>& GetTriangles() const { return m_Triangles; }
 		const fastgltf::Asset& GetGltfAsset() const { return m_GltfAsset; }
 		const std::filesystem::path& GetFilepath() const { return m_Filepath; }
+		const std::vector<DecodedImage>& GetImages() const { return m_Images; }
 
 
 	private:
@@ -65,12 +94,14 @@ namespace Assets {
 		std::vector<Vertex> m_Vertices;
 		std::vector<uint> m_Indicies;
 		std::vector<Triangle> m_Triangles;
+		std::vector<DecodedImage> m_Images;
 
 		// Private helper methods for scene graph traversal and data extraction.
 		// These are non-static as they implicitly access class members like m_GltfAsset.
 		void ProcessScene(fastgltf::Scene& scene);
 		void ProcessNode(fastgltf::Scene* scene, int const gltfNodeIndex);
 		void LoadVertexData(uint const meshIndex);
+		std::vector<uint8_t> ReadImageSource(const fastgltf::Image& image) const;
 
 		template<typename T>
 		fastgltf::ComponentType LoadAccessor(const fastgltf::Accessor& accessor,
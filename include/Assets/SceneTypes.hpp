@@ -9,6 +9,9 @@ namespace Scene {
 	struct Sampler {
 		std::string name;
 		VkSampler sampler;
+		// Kept for deciding which images may be packed into an atlas.
+		VkSamplerAddressMode addressModeU;
+		VkSamplerAddressMode addressModeV;
 	};
 
 	struct Image {
@@ -22,6 +25,10 @@ namespace Scene {
 		std::string name;
 		size_t sampler;
 		size_t image;
+		// Set when the image was packed into a texture atlas; image then indexes the atlas list.
+		std::optional<uint32_t> atlasLayer;
+		glm::vec2 uvOffset{0.0f};
+		glm::vec2 uvScale{1.0f};
 	};
 
 	struct Material {
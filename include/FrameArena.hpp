@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+/**
+ * @brief Monotonic arena for scratch memory that lives for one frame. Deallocation
+ * is a no-op; Reset releases everything at once. Blocks are kept across resets, and
+ * when a frame needed more than one block they are merged into a single block of the
+ * combined size, so a steady workload stops allocating after the first few frames.
+ * Not thread safe; give every thread its own arena.
+ */
+class FrameArena : public std::pmr::memory_resource {
+public:
+	explicit FrameArena(size_t blockSize = 64 * 1024);
+	~FrameArena() override;
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void Reset();
+
+	size_t GetBytesUsed() const { return m_BytesUsed; }
+	size_t GetPeakBytesUsed() const { return m_PeakBytesUsed; }
+	size_t GetCapacity() const;
+	// Blocks requested from the heap since construction.
+	uint64_t GetBlockAllocations() const { return m_BlockAllocations; }
+
+private:
+	struct Block {
+		std::byte* data;
+		size_t size;
+	};
+
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	void AddBlock(size_t minimumSize);
+
+	std::vector<Block> m_Blocks;
+	size_t m_Current = 0;	// block allocations are served from
+	size_t m_Offset = 0;	// into the current block
+	size_t m_BlockSize;
+	size_t m_BytesUsed = 0;
+	size_t m_PeakBytesUsed = 0;
+	uint64_t m_BlockAllocations = 0;
+};
+
+// Number of operator new calls made by the calling thread so far. Sample it around a
+// frame to check that steady-state frames do not touch the heap.
+uint64_t GetThreadHeapAllocationCount();
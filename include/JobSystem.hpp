@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed pool of worker threads for CPU work that can be fanned out
+ * (image decoding, command recording, ...). Jobs must not block on each other,
+ * and jobs passed to Dispatch must not throw.
+ */
+class JobSystem {
+public:
+	// threadCount 0 picks one worker per hardware thread minus the calling thread.
+	explicit JobSystem(uint32_t threadCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void Dispatch(std::function<void()> job);
+
+	/**
+	 * @brief Runs job(i) for every i in [0, count) on the workers and the calling
+	 * thread, returning once all of them finished. The first exception thrown by a
+	 * job is rethrown on the calling thread.
+	 */
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+	// Blocks until every dispatched job has finished.
+	void Wait();
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+	// 0 on threads outside the pool, 1..GetThreadCount() on workers.
+	static uint32_t GetCurrentThreadIndex();
+
+private:
+	void WorkerLoop(uint32_t index);
+
+	std::vector<std::thread> m_Workers;
+	std::deque<std::function<void()>> m_Queue;
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeWorkers;
+	std::condition_variable m_Idle;
+	uint32_t m_Running = 0;
+	bool m_Stop = false;
+};
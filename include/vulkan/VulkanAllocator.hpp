@@ -0,0 +1,21 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+// Creates the engine-wide VMA allocator. Every buffer and image allocation goes through it,
+// suballocated from large device memory blocks.
+void createAllocator(VulkanEngine* engine);
+void destroyAllocator(VulkanEngine* engine);
+
+void logAllocatorStats(VulkanEngine* engine);
+
+// Device-local heaps above this fraction of their budget ask the pressure handlers to
+// free memory until usage is back down to MEMORY_PRESSURE_TARGET.
+constexpr double MEMORY_PRESSURE_THRESHOLD = 0.9;
+constexpr double MEMORY_PRESSURE_TARGET = 0.8;
+
+// Refreshes _vk.memoryBudget and runs the pressure handlers if needed; call once per frame.
+void updateMemoryBudget(VulkanEngine* engine);
+// Returns an id for unregisterMemoryPressureHandler. Handlers run on the render thread.
+uint32_t registerMemoryPressureHandler(MemoryPressureHandler handler, VulkanEngine* engine);
+void unregisterMemoryPressureHandler(uint32_t id, VulkanEngine* engine);
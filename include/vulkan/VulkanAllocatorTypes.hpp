@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "vk_mem_alloc.h"
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Asked to give back device-local memory; returns the number of bytes it actually freed.
+using MemoryPressureHandler = std::function<VkDeviceSize(VkDeviceSize bytesToFree)>;
+
+/**
+ * @brief Per-heap budget and usage, refreshed every frame. With VK_EXT_memory_budget the
+ * numbers come from the driver and include other processes; without it VMA estimates
+ * them from its own allocations and 80% of the heap size.
+ */
+struct MemoryBudget {
+	bool extensionEnabled = false;
+	std::vector<VmaBudget> heaps;
+	std::vector<VkMemoryHeapFlags> heapFlags;
+
+	uint32_t frameIndex = 0;
+	bool underPressure = false;
+	uint64_t pressureEvents = 0;	// times usage crossed the threshold
+
+	uint32_t nextHandlerId = 1;
+	std::vector<std::pair<uint32_t, MemoryPressureHandler>> handlers;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief How a command is about to use a resource. Each access maps to the stages,
+ * access bits and (for images) layout it needs; the tracker derives the barrier from
+ * that and the resource's last known state.
+ */
+enum class ResourceAccess {
+	TransferRead,
+	TransferWrite,
+	VertexInput,			// vertex and index fetch
+	IndirectRead,
+	VertexShaderRead,
+	FragmentShaderRead,
+	FragmentShaderWrite,
+	ComputeShaderRead,
+	ComputeShaderWrite,
+	ColorAttachmentWrite,
+	DepthAttachmentWrite,
+	DepthAttachmentRead,
+	HostRead,
+	Present,
+};
+
+/**
+ * @brief Last known synchronization state of a whole image. readStages are the stages
+ * that already see the last write; a write or layout change has to wait for them too.
+ */
+struct ImageState {
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+	VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+};
+
+struct BufferState {
+	VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+	VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+};
+
+// Tracked on the render thread, keyed by handle; entries are dropped when the resource is destroyed.
+struct ResourceStates {
+	std::unordered_map<VkImage, ImageState> images;
+	std::unordered_map<VkBuffer, BufferState> buffers;
+
+	uint64_t barrierCalls = 0;	// vkCmdPipelineBarrier2 calls issued
+	uint64_t barriers = 0;		// image, buffer and memory barriers in them
+};
+
+// Barriers collected for one point in a command buffer and issued with a single vkCmdPipelineBarrier2.
+struct BarrierBatch {
+	BarrierBatch() = default;
+	explicit BarrierBatch(std::pmr::memory_resource* resource)
+		: images(resource), buffers(resource), memory(resource) {}
+
+	bool empty() const { return images.empty() && buffers.empty() && memory.empty(); }
+
+	std::pmr::vector<VkImageMemoryBarrier2> images;
+	std::pmr::vector<VkBufferMemoryBarrier2> buffers;
+	std::pmr::vector<VkMemoryBarrier2> memory;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+struct ResourceAccessInfo {
+	VkPipelineStageFlags2 stages;
+	VkAccessFlags2 access;
+	VkImageLayout layout;
+	bool write;
+};
+
+ResourceAccessInfo describeAccess(ResourceAccess access);
+
+/**
+ * @brief Adds whatever barrier the image needs before `access` to the batch and records
+ * the new state. Read-after-read in the same layout adds nothing. Images the tracker has
+ * not seen are assumed UNDEFINED, so their contents may be discarded.
+ */
+void requireImageAccess(BarrierBatch& batch, VkImage image, const VkImageSubresourceRange& range, ResourceAccess access, VulkanEngine* engine);
+void requireBufferAccess(BarrierBatch& batch, VkBuffer buffer, ResourceAccess access, VulkanEngine* engine);
+// Global dependency for resources that are not tracked individually.
+void requireMemoryAccess(BarrierBatch& batch, ResourceAccess from, ResourceAccess to);
+
+// Records every collected barrier with one vkCmdPipelineBarrier2 and empties the batch.
+void flushBarriers(VkCommandBuffer commandBuffer, BarrierBatch& batch, VulkanEngine* engine);
+
+// For images whose state changed outside the tracker: render pass final layouts, queue family acquires.
+// The image is treated as visible to `access` with no write pending.
+void setImageState(VkImage image, ResourceAccess access, VulkanEngine* engine);
+// Marks the contents as no longer needed so the next access transitions from UNDEFINED. It still
+// waits for the image's earlier accesses, plus waitStages/waitAccess (other images aliasing its
+// memory, or the stage a semaphore wait unblocks).
+void discardImage(VkImage image, VkPipelineStageFlags2 waitStages, VkAccessFlags2 waitAccess, VulkanEngine* engine);
+const ImageState* findImageState(VkImage image, VulkanEngine* engine);
+// For resources handed to another queue through a semaphore wait, which already covers their
+// earlier accesses; only an image's layout is kept. The old stages may not even exist on the new queue.
+void settleImage(VkImage image, VulkanEngine* engine);
+void settleBuffer(VkBuffer buffer, VulkanEngine* engine);
+// Drop the state before the handle is destroyed so a new resource reusing it starts UNDEFINED.
+void forgetImage(VkImage image, VulkanEngine* engine);
+void forgetBuffer(VkBuffer buffer, VulkanEngine* engine);
+
+VkImageSubresourceRange colorRange(uint32_t mipLevels = 1, uint32_t layerCount = 1);
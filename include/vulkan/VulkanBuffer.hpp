@@ -3,12 +3,35 @@
 #include <vector>
 #include "VulkanEngine.hpp"
 
-void createVertexBuffer(std::vector<Vertex> vertices, VulkanEngine* engine);
-void createIndexBuffer(std::vector<uint32_t> indices, VulkanEngine* engine);
-void createUniformBuffers(VulkanEngine* engine);
-void updateUniformBuffer(uint32_t currentImage, VulkanEngine* engine, float scale);
-VkCommandBuffer beginSingleTimeCommands(VulkanEngine *engine);
-void endSingleTimeCommands(VkCommandBuffer commandBuffer, VulkanEngine *engine);
-void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VulkanEngine* engine);
-void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory, VulkanEngine* engine);
-uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VulkanEngine* engine);
+struct UploadBatch;
+
+// The per-draw uniforms of buildDrawList fill the frame allocator region beyond this many benchmark draws.
+constexpr uint32_t MAX_DRAW_LIST_BENCHMARK_DRAWS = 50000;
+// Instances buildInstancedDrawList can write per frame; the benchmark slider tops out at 100k.
+constexpr uint32_t MAX_SCENE_INSTANCES = 128 * 1024;
+
+// Also records the mesh's bounding sphere in meshBounds.
+void createVertexBuffer(const std::vector<Vertex>& vertices, UploadBatch& uploads, VulkanEngine* engine);
+void createIndexBuffer(const std::vector<uint32_t>& indices, UploadBatch& uploads, VulkanEngine* engine);
+// Host-written instanceBuffer with a region of MAX_SCENE_INSTANCES per frame in flight.
+void createInstanceBuffer(VulkanEngine* engine);
+// Appends the frame's draws, each with its UniformBufferObject in the frame allocator: the
+// scene object followed by benchmarkDraws copies laid out on a grid.
+void buildDrawList(std::pmr::vector<DrawItem>& draws, float scale, uint32_t benchmarkDraws, VulkanEngine* engine);
+// The same scene as one instanced draw per mesh: each object's model matrix goes into the
+// current frame's region of instanceBuffer, grouped so a mesh's instances are contiguous.
+void buildInstancedDrawList(std::pmr::vector<DrawItem>& draws, float scale, uint32_t benchmarkDraws, VulkanEngine* engine);
+// The same scene for the GPU-driven path: one camera uniform and a GpuObject per object,
+// culled and drawn on the GPU.
+void buildGpuScene(float scale, uint32_t benchmarkDraws, VulkanEngine* engine);
+// Begins a command buffer from the queue's one-shot pool; it is recycled once its submission retires.
+VkCommandBuffer beginSingleTimeCommands(UploadQueue queue, VulkanEngine *engine);
+// Submits without waiting. Later submissions on the same queue see the results.
+// Returns the submission's ticket for isUploadComplete / waitForUpload.
+uint64_t endSingleTimeCommands(VkCommandBuffer commandBuffer, UploadQueue queue, VulkanEngine *engine);
+// Buffers created with a VMA_ALLOCATION_CREATE_HOST_ACCESS_* flag are host coherent and
+// persistently mapped at allocationInfo.pMappedData; all others are device local.
+AllocatedBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags, VulkanEngine* engine);
+// Same, but usable from the graphics and async compute queues without ownership transfers.
+AllocatedBuffer createSharedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags, VulkanEngine* engine);
+void destroyBuffer(AllocatedBuffer& buffer, VulkanEngine* engine);
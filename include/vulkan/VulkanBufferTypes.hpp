@@ -14,5 +14,5 @@ struct AllocatedBuffer {
 struct AllocatedImage {
 	VkImage image = VK_NULL_HANDLE;
 	VmaAllocation allocation = VK_NULL_HANDLE;
-	VmaAllocationInfo allocationInfo;
+	VmaAllocationInfo allocationInfo{};
 };
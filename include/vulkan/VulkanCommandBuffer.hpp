@@ -2,6 +2,33 @@
 
 #include "VulkanEngine.hpp"
 
+#include <span>
+
+// Draw lists shorter than this per thread are not worth a secondary command buffer of their own.
+constexpr uint32_t MIN_DRAWS_PER_SECONDARY = 256;
+
 void createCommandPool(VulkanEngine* engine);
 void createCommandBuffers(VulkanEngine* engine);
-void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, VulkanEngine* engine);
\ No newline at end of file
+void destroyCommandPools(VulkanEngine* engine);
+
+// A reset primary command buffer for one-shot work on the queue; allocates only when none is available.
+VkCommandBuffer acquireOneShotCommandBuffer(UploadQueue queue, VulkanEngine* engine);
+// Returns a command buffer whose submission has completed.
+void recycleOneShotCommandBuffer(UploadQueue queue, VkCommandBuffer commandBuffer, VulkanEngine* engine);
+
+void createRecordingPools(VulkanEngine* engine);
+void destroyRecordingPools(VulkanEngine* engine);
+// Recycles the secondary command buffers of a frame in flight; call once waitForFrameSlot returned for it.
+void resetRecordingPools(uint32_t frame, VulkanEngine* engine);
+// Call when anything the scene draws bind changes (descriptor sets, buffers, extent).
+void invalidateSceneCommands(VulkanEngine* engine);
+
+/**
+ * @brief Records the frame through the render graph. In the scene pass the draws are split
+ * into contiguous chunks recorded into secondary command buffers on the job system, which
+ * the primary executes in order followed by the ImGui overlay. With the scene command cache
+ * enabled the chunks are kept per frame in flight and only re-recorded when the draw count
+ * or the cache version changed. With GPU culling enabled, draws is empty: the graph culls
+ * the submitted GpuObjects first and the scene is a single indirect count draw.
+ */
+void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, std::span<const DrawItem> draws, VulkanEngine* engine);
\ No newline at end of file
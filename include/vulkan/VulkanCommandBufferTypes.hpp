@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "VulkanEngine.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Command buffers for one-shot work on one queue. The pool is transient and allows
+ * per-buffer resets, so a buffer goes back to available once its submission's timeline
+ * value is reached and is reset implicitly when it is begun again.
+ */
+struct OneShotCommandPool {
+	VkCommandPool pool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> available;
+	uint32_t allocated = 0;
+};
+
+// One indexed draw of the scene; uniformOffset is the dynamic offset of its UniformBufferObject.
+struct DrawItem {
+	uint32_t uniformOffset;
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	// Range of the frame's InstanceData; only the instanced pipeline reads it.
+	uint32_t firstInstance = 0;
+	uint32_t instanceCount = 1;
+};
+
+// Secondary command buffers of one recording thread for one frame in flight. The pool is
+// reset as a whole once the frame slot has been waited for; the buffers are reused.
+struct ThreadCommandPool {
+	VkCommandPool pool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> secondaries;
+	uint32_t used = 0;
+};
+
+/**
+ * @brief Scene draws recorded once per frame in flight and executed again on later frames.
+ * Per-draw uniforms sit at frame allocator offsets that only depend on the draw list, so the
+ * commands stay valid until something they bind changes; bump version when that happens.
+ */
+struct SceneCommandCache {
+	bool enabled = false;
+	uint64_t version = 1;
+	// Index [frame][thread] like VulkanContext::recordingPools, but only reset when the slot is re-recorded.
+	std::array<std::vector<ThreadCommandPool>, MAX_FRAMES_IN_FLIGHT> pools;
+	std::array<std::vector<VkCommandBuffer>, MAX_FRAMES_IN_FLIGHT> secondaries;
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> recordedVersions{};
+	std::array<size_t, MAX_FRAMES_IN_FLIGHT> recordedDraws{};
+	uint64_t recordings = 0;
+};
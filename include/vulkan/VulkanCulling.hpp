@@ -0,0 +1,57 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+#include <array>
+#include <span>
+
+// Objects the GPU-driven path can cull per frame; the benchmark slider tops out at 100k.
+constexpr uint32_t MAX_GPU_OBJECTS = 128 * 1024;
+// Where the second occlusion phase puts its draws, in GpuCulling::drawCommands and its count
+// in GpuCulling::counters; the early draws and their count start at 0.
+constexpr VkDeviceSize LATE_DRAW_COMMANDS_OFFSET = MAX_GPU_OBJECTS * sizeof(VkDrawIndexedIndirectCommand);
+constexpr VkDeviceSize LATE_DRAW_COUNT_OFFSET = sizeof(uint32_t);
+
+// This frame's culling output, for the passes that draw from it. The occlusion resources
+// are only declared when the frame culls occlusion.
+struct CullingGraphResources {
+	RenderGraphResource drawCommands;
+	RenderGraphResource counters;
+	RenderGraphResource occludedFlags;
+	RenderGraphResource depthPyramid;
+};
+
+// Buffers, compute pipelines, depth pyramid and indirect draw pipeline of the GPU-driven
+// path. Does nothing without GpuCulling::supported. Call before createDescriptorSets.
+void createGpuCulling(VulkanEngine* engine);
+void destroyGpuCulling(VulkanEngine* engine);
+
+// Normalized Gribb-Hartmann planes of a depth zero-to-one projection, pointing inwards:
+// left, right, bottom, top, near, far.
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& viewProjection);
+
+// Copies the frame's objects into the current slot's object buffer, to be culled against the
+// camera's frustum and, with occlusion culling, the depth pyramid. cameraOffset is the
+// camera's dynamic uniform offset for the draw.
+void submitGpuObjects(std::span<const GpuObject> objects, const UniformBufferObject& camera, uint32_t cameraOffset,
+	VulkanEngine* engine);
+
+// Whether the current frame culls occlusion and so draws the scene in two passes.
+bool isCullingOcclusion(VulkanEngine* engine);
+
+// Adds the passes that reset the counters and cull; declare them before the passes that draw.
+CullingGraphResources addCullingPasses(VulkanEngine* engine);
+/**
+ * @brief Adds the depth pyramid reduction of depth and the second culling phase. Declare them
+ * after the scene pass drawing the early draws and before the one drawing the late draws.
+ */
+void addOcclusionPasses(const CullingGraphResources& resources, RenderGraphResource depth, VulkanEngine* engine);
+// Adds the readback of the counters, and of the draws when validating; declare it after the passes that draw.
+void addCullingReadback(const CullingGraphResources& resources, VulkanEngine* engine);
+
+/**
+ * @brief Reads back what the GPU culled the last time this frame slot was used and, if that
+ * frame was validated, compares it with the CPU reference culler. Call once waitForFrameSlot
+ * returned for the slot, before the slot's objects are submitted again.
+ */
+void collectCullingResults(uint32_t frame, VulkanEngine* engine);
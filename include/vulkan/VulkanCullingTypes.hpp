@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "VulkanEngine.hpp"
+#include "VulkanBufferTypes.hpp"
+#include "VulkanTypes.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Levels a depth pyramid can have: enough for a 64k wide depth buffer.
+constexpr uint32_t MAX_DEPTH_PYRAMID_LEVELS = 16;
+
+/**
+ * @brief Max-depth mip chain of the depth buffer, for occlusion culling. Level 0 is the depth
+ * extent rounded down to powers of two, so each of its texels covers up to 3x3 depth texels.
+ * Persistent: a frame culls against the pyramid the frame before it built.
+ */
+struct DepthPyramid {
+	AllocatedImage image;
+	VkImageView view = VK_NULL_HANDLE;			// every level, for culling
+	std::vector<VkImageView> levelViews;		// one per level, for the reduction
+	VkExtent2D extent{};
+	uint32_t levels = 0;
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	// Camera the pyramid was built with, and the frameNumber of the frame that may cull against it.
+	glm::mat4 viewProjection{ 1.0f };
+	uint64_t validForFrame = UINT64_MAX;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	// Per frame in flight, one per level: the level below (or depth) as source, the level as destination.
+	std::array<std::array<VkDescriptorSet, MAX_DEPTH_PYRAMID_LEVELS>, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+/**
+ * @brief GPU-driven scene: a compute pass frustum-culls the frame's objects and compacts the
+ * survivors into indirect draw commands, drawn with one vkCmdDrawIndexedIndirectCount.
+ */
+struct GpuCulling {
+	bool supported = false;	// multiDrawIndirect, drawIndirectFirstInstance and drawIndirectCount
+	bool enabled = false;
+	bool asyncCompute = false;	// cull on the async compute queue, unless culling occlusion
+	bool validate = false;		// compare every frame with the CPU reference culler
+	// Two-phase occlusion culling against a depth pyramid; needs a depth format that can be sampled.
+	bool occlusionSupported = false;
+	bool occlusion = false;
+
+	// Written by the host, one per frame in flight: the objects, and the culling parameters.
+	std::array<AllocatedBuffer, MAX_FRAMES_IN_FLIGHT> objectBuffers;
+	std::array<AllocatedBuffer, MAX_FRAMES_IN_FLIGHT> paramsBuffers;
+	// VkDrawIndexedIndirectCommand per visible object: the early draws, then MAX_GPU_OBJECTS
+	// further on the late draws of the second occlusion phase.
+	AllocatedBuffer drawCommands;
+	// CullingCounters: both draw counts and what each phase culled.
+	AllocatedBuffer counters;
+	// Per object, whether the first phase rejected it as occluded, for the second to test again.
+	AllocatedBuffer occludedFlags;
+	// The counters, followed by the draw commands when validating.
+	std::array<AllocatedBuffer, MAX_FRAMES_IN_FLIGHT> readbackBuffers;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipeline drawPipeline = VK_NULL_HANDLE;
+	DepthPyramid pyramid;
+
+	// Dynamic offset of the current frame's camera UniformBufferObject.
+	uint32_t cameraOffset = 0;
+	// What each frame slot culled last; objectCounts is 0 once its results were collected.
+	std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> objectCounts{};
+	std::array<std::array<glm::vec4, 6>, MAX_FRAMES_IN_FLIGHT> frustums{};
+	std::array<bool, MAX_FRAMES_IN_FLIGHT> validating{};
+	std::array<bool, MAX_FRAMES_IN_FLIGHT> occluding{};
+	std::array<std::vector<GpuObject>, MAX_FRAMES_IN_FLIGHT> referenceObjects;
+
+	// Of the last frame collected.
+	uint32_t visibleObjects = 0;
+	uint32_t frustumCulledObjects = 0;
+	uint32_t earlyOccludedObjects = 0;	// rejected by the first phase against the previous pyramid
+	uint32_t lateOccludedObjects = 0;	// of those, still rejected by the second phase
+	uint64_t validatedFrames = 0;
+	uint64_t mismatchedFrames = 0;
+};
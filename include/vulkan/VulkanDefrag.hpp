@@ -0,0 +1,35 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+// Fragmentation is checked this often; a run starts when the default pools waste more
+// than DEFRAG_MIN_WASTED_BYTES and DEFRAG_MIN_WASTED_FRACTION of their blocks.
+constexpr uint64_t DEFRAG_CHECK_INTERVAL = 600;
+constexpr VkDeviceSize DEFRAG_MIN_WASTED_BYTES = 32ull * 1024 * 1024;
+constexpr double DEFRAG_MIN_WASTED_FRACTION = 0.25;
+// Upper bound of the copies a single pass records into a frame.
+constexpr VkDeviceSize DEFRAG_MAX_BYTES_PER_PASS = 8ull * 1024 * 1024;
+constexpr uint32_t DEFRAG_MAX_ALLOCATIONS_PER_PASS = 32;
+
+// Lets the defragmenter move a device-local resource. It needs TRANSFER_SRC usage (images:
+// optimal tiling, one sample, kept in SHADER_READ_ONLY_OPTIMAL). destroyBuffer / destroyImage
+// unregister it again.
+void registerMovableBuffer(const AllocatedBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage,
+		std::function<void(VkBuffer)> relocate, VulkanEngine* engine);
+void registerMovableImage(const AllocatedImage& image, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers,
+		VkFormat format, VkImageUsageFlags usage, std::function<void(VkImage)> relocate, VulkanEngine* engine);
+
+// Runs work (typically destroying views of a moved image) once the current pass has ended.
+void deferUntilDefragPassEnds(std::function<void()> work, VulkanEngine* engine);
+
+/**
+ * @brief Unregisters a movable allocation. Returns true when it is being moved by the
+ * active pass: the pass then frees the memory, so the caller must only destroy the
+ * VkBuffer / VkImage handle.
+ */
+bool releaseMovable(VmaAllocation allocation, VulkanEngine* engine);
+
+// Advances defragmentation by at most one pass; call once per frame after waitForFrameSlot.
+void updateDefragmentation(VulkanEngine* engine);
+// Finishes the running pass and abandons the rest of the run; the device must be idle.
+void destroyDefragmenter(VulkanEngine* engine);
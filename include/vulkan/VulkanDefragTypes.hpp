@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "vk_mem_alloc.h"
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief How to recreate a device-local resource that the defragmenter may move, and
+ * who to tell. The relocate callback receives the new handle once its contents have
+ * been copied and must swap it in everywhere the old one is referenced.
+ */
+struct MovableResource {
+	VkBuffer buffer = VK_NULL_HANDLE;	// handle currently bound to the allocation
+	VkImage image = VK_NULL_HANDLE;
+	VkBufferCreateInfo bufferInfo{};	// sType is set for buffers
+	VkImageCreateInfo imageInfo{};		// sType is set for images
+	std::function<void(VkBuffer)> relocateBuffer;
+	std::function<void(VkImage)> relocateImage;
+};
+
+struct DefragMove {
+	VmaAllocation allocation;
+	uint32_t moveIndex;		// into the pass's pMoves
+	VkBuffer oldBuffer = VK_NULL_HANDLE;
+	VkImage oldImage = VK_NULL_HANDLE;
+};
+
+/**
+ * @brief Incremental VMA defragmentation. Each pass copies a bounded number of bytes on
+ * the graphics queue, swaps the new handles in right away and only ends once every
+ * frame that could still use the old handles has finished, so frames never wait on it.
+ */
+struct Defragmenter {
+	std::unordered_map<VmaAllocation, MovableResource> movable;
+
+	VmaDefragmentationContext context = VK_NULL_HANDLE;
+	VmaDefragmentationPassMoveInfo pass{};
+	bool passActive = false;
+	uint64_t passFrame = 0;	// last frame submitted with the old handles
+	uint64_t copySubmission = 0;
+	std::vector<DefragMove> moves;
+	std::vector<std::function<void()>> retired;	// run when the pass ends
+
+	uint64_t frame = 0;
+	uint64_t runs = 0;
+	uint64_t passes = 0;
+	uint64_t bytesMoved = 0;
+	uint64_t bytesFreed = 0;
+	uint64_t blocksFreed = 0;
+	double lastPassMilliseconds = 0.0;
+	double maxPassMilliseconds = 0.0;
+};
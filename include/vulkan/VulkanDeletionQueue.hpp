@@ -0,0 +1,21 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+// Queues destroy to run once every frame submitted so far has finished on the GPU.
+// Work still pending on the transfer queue is not covered; wait for its ticket first.
+void deferDestroy(std::function<void()> destroy, VulkanEngine* engine);
+// Take ownership of the handle and reset the caller's copy. Resources registered with the
+// defragmenter may move before the destroy runs; defer a closure that reads their owner instead.
+void deferDestroyBuffer(AllocatedBuffer& buffer, VulkanEngine* engine);
+void deferDestroyImage(AllocatedImage& image, VulkanEngine* engine);
+void deferDestroyImageView(VkImageView& view, VulkanEngine* engine);
+void deferDestroyFramebuffer(VkFramebuffer& framebuffer, VulkanEngine* engine);
+void deferDestroyPipeline(VkPipeline& pipeline, VulkanEngine* engine);
+void deferDestroySemaphore(VkSemaphore& semaphore, VulkanEngine* engine);
+
+// Runs the destroys whose frames the GPU has finished; call once per frame.
+void collectDeletionQueue(VulkanEngine* engine);
+
+// Runs everything that is still queued; the device must be idle.
+void flushDeletionQueue(VulkanEngine* engine);
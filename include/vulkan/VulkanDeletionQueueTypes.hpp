@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+/**
+ * @brief Destroy requests tagged with the number of the frame being recorded when they
+ * were made. They run once the GPU has finished that frame, so nothing a frame in
+ * flight still reads is destroyed under it.
+ */
+struct DeletionQueue {
+	std::deque<std::pair<uint64_t, std::function<void()>>> pending;	// oldest first
+	uint64_t destroyed = 0;
+};
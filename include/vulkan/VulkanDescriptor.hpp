@@ -4,4 +4,6 @@
 
 void createDescriptorSetLayout(VulkanEngine* engine);
 void createDescriptorPool(VulkanEngine* engine);
-void createDescriptorSets(VulkanEngine* engine);
\ No newline at end of file
+void createDescriptorSets(VulkanEngine* engine);
+// Rewrites the set of one frame in flight; only call once waitForFrameSlot returned for it.
+void updateDescriptorSet(uint32_t frame, VulkanEngine* engine);
\ No newline at end of file
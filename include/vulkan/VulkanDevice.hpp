@@ -5,6 +5,10 @@
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	// A transfer-capable family without graphics, preferably without compute either.
+	std::optional<uint32_t> transferFamily;
+	// A compute family without graphics with a queue to spare after the transfer queue.
+	std::optional<uint32_t> computeFamily;
 
 	bool isComplete() const { return graphicsFamily.has_value(); }
 };
@@ -13,4 +17,5 @@ void pickPhysicalDevice(VulkanEngine* engine);
 void createLogicalDevice(VulkanEngine* engine);
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VulkanEngine* engine);
 bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
 bool isDeviceSuitable(VkPhysicalDevice device, VulkanEngine* engine);
\ No newline at end of file
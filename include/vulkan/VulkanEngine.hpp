@@ -20,15 +20,45 @@ const int MAX_FRAMES_IN_FLIGHT = 2;
 
 const bool bEnableValidationLayers = true;
 #include "Assets/SceneTypes.hpp"
-
+#include "VulkanTextureTypes.hpp"
+#include "VulkanAllocatorTypes.hpp"
+#include "VulkanBarrierTypes.hpp"
+#include "VulkanCommandBufferTypes.hpp"
+#include "VulkanCullingTypes.hpp"
+#include "VulkanDefragTypes.hpp"
+#include "VulkanDeletionQueueTypes.hpp"
+#include "VulkanFrameAllocatorTypes.hpp"
+#include "VulkanRenderGraphTypes.hpp"
+#include "VulkanStagingTypes.hpp"
+#include "VulkanSyncTypes.hpp"
+#include "VulkanTransientTypes.hpp"
+#include "JobSystem.hpp"
+#include "FrameArena.hpp"
+
+#include <memory>
+
+struct VirtualTexture;
 
 struct VulkanContext {
 	VkInstance instance;
 	VkDebugUtilsMessengerEXT debugMessenger;
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	VkDevice device;
+	VmaAllocator allocator = VK_NULL_HANDLE;
+	MemoryBudget memoryBudget;
+	Defragmenter defragmenter;
+	DeletionQueue deletionQueue;
+	ResourceStates resourceStates;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	// Same queue as graphicsQueue when the device has no separate transfer family.
+	VkQueue transferQueue;
+	// Same queue as graphicsQueue unless asyncCompute.
+	VkQueue computeQueue;
+	uint32_t graphicsQueueFamily = 0;
+	uint32_t transferQueueFamily = 0;
+	uint32_t computeQueueFamily = 0;
+	bool asyncCompute = false;
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapchain;
 	std::vector<VkImage> swapchainImages;
@@ -37,47 +67,100 @@ struct VulkanContext {
 	VkExtent2D swapchainExtent;
 
 	VkCommandPool commandPool;
+	VkCommandPool computeCommandPool = VK_NULL_HANDLE;	// only with asyncCompute
+	// Indexed by UploadQueue.
+	std::array<OneShotCommandPool, 2> oneShotPools;
 	std::vector<VkCommandBuffer> commandBuffers;
+	// Index [frame][thread]; thread 0 is the render thread, the rest are job system workers.
+	std::array<std::vector<ThreadCommandPool>, MAX_FRAMES_IN_FLIGHT> recordingPools;
+	// Threads the draw list is split across; 0 uses every job system thread.
+	uint32_t recordingThreads = 0;
+	double recordingMilliseconds = 0.0;
+	SceneCommandCache sceneCommands;
+	GpuCulling gpuCulling;
+	// CPU time from building the draw list to submitting the frame.
+	double frameCpuMilliseconds = 0.0;
+
+	StagingRing stagingRing;
 
 	std::vector<VkFramebuffer> swapchainFramebuffers;
 	VkRenderPass renderPass;
+	// The scene split in two for occlusion culling: early stores depth for the depth pyramid,
+	// late loads color and depth. Both are compatible with renderPass.
+	VkRenderPass earlyRenderPass;
+	VkRenderPass lateRenderPass;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline graphicsPipeline;
+	// Takes the model matrix from InstanceData at binding 1 instead of the draw's uniforms.
+	VkPipeline instancedPipeline;
+
+	RenderGraph renderGraph;
+	TransientImages transientImages;
+	VkFormat depthFormat;
+	TransientImageHandle depthImage;
 
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
-	std::vector<VkFence> imagesInFlight;
+
+	// Every submission to a queue signals the next value of that queue's timeline.
+	QueueTimeline graphicsTimeline;
+	QueueTimeline transferTimeline;
+	QueueTimeline computeTimeline;
+	uint64_t frameNumber = 0;	// frames submitted so far, numbered from 1
+	uint64_t completedFrame = 0;	// newest frame the GPU is known to have finished
+	// Graphics timeline value signalled by the frame last submitted from each slot.
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frameTimelineValues{};
 
 	bool framebufferResized = false;
 	uint32_t currentFrame = 0;
-
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
-
-	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
+	// Transfer timeline value the frame being recorded has to wait for; 0 if none.
+	uint64_t uploadWaitValue = 0;
+
+	AllocatedBuffer vertexBuffer;
+	AllocatedBuffer indexBuffer;
+	// Object space bounding sphere of the scene mesh: center, radius.
+	glm::vec4 meshBounds{};
+
+	TextureCache textureCache;
+	TextureHandle texture = INVALID_TEXTURE_HANDLE;
+	std::vector<TextureAtlas> textureAtlases;
+	SamplerCache samplerCache;
+	// One entry per glTF sampler of the loaded model, followed by the glTF default sampler.
+	std::vector<Scene::Sampler> sceneSamplers;
+	// One entry per glTF texture of the loaded model.
+	std::vector<Scene::Texture> sceneTextures;
 	VkImageView textureImageView;
 	VkSampler textureSampler;
 
-	VkBuffer instanceBuffer;
-	VkDeviceMemory instanceBufferMemory;
+	// InstanceData of the instanced draw path, one region of MAX_SCENE_INSTANCES per frame in
+	// flight; instanceCount is how many the current frame wrote.
+	AllocatedBuffer instanceBuffer;
+	bool instancedDrawing = false;
 
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
-	std::vector<void*> uniformBuffersMapped;
+	FrameAllocator frameAllocator;
+	// CPU scratch memory per frame in flight, one arena per job system thread (0 = render thread).
+	std::array<std::vector<std::unique_ptr<FrameArena>>, MAX_FRAMES_IN_FLIGHT> frameArenas;
+	// Heap allocations the render thread made during the last frame.
+	uint64_t frameHeapAllocations = 0;
 
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorPool imguiDescriptorPool;
 
+	// One per frame in flight; binding 0 points into the frame allocator with a dynamic offset.
 	std::vector<VkDescriptorSet> descriptorSets;
+	// Bit per frame in flight whose set must be rewritten before that frame is recorded.
+	uint32_t descriptorSetsDirty = 0;
+
+	// Virtual textures write their feedback from fragment shaders, which needs fragmentStoresAndAtomics.
+	bool virtualTexturesSupported = false;
+	std::vector<VirtualTexture*> virtualTextures;
+	// Sampled instead of the scene texture by the per-draw path while drawVirtualTexture is set.
+	VirtualTexture* sceneVirtualTexture = nullptr;
+	bool drawVirtualTexture = false;
 
 	uint32_t indexCount = 0;
-	uint32_t instanceCount;
+	uint32_t instanceCount = 0;
 };
 
 
@@ -88,6 +171,7 @@ public:
 	// --- Members ---
 	GLFWwindow* _window = nullptr;
 	VulkanContext _vk;
+	JobSystem _jobs;
 
 	void initImgui();
 
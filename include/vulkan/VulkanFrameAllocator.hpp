@@ -0,0 +1,35 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+// Room for a UniformBufferObject per draw of a 50k draw benchmark frame.
+constexpr VkDeviceSize FRAME_ALLOCATOR_REGION_SIZE = 16ull * 1024 * 1024;
+
+void createFrameAllocator(VkDeviceSize regionSize, VulkanEngine* engine);
+void destroyFrameAllocator(VulkanEngine* engine);
+
+// Switches to the region of the given frame in flight; call once waitForFrameSlot returned for it.
+void resetFrameAllocator(uint32_t frame, VulkanEngine* engine);
+
+/**
+ * @brief Bump-allocates size bytes from the current frame's region. The memory is host
+ * coherent and only valid until the frame slot comes around again, so write it every
+ * frame. Throws when the region is exhausted.
+ */
+FrameAllocation allocateFrameData(VkDeviceSize size, VkDeviceSize alignment, VulkanEngine* engine);
+// Aligned for UNIFORM_BUFFER_DYNAMIC / STORAGE_BUFFER_DYNAMIC descriptors respectively.
+FrameAllocation allocateFrameUniform(VkDeviceSize size, VulkanEngine* engine);
+FrameAllocation allocateFrameStorage(VkDeviceSize size, VulkanEngine* engine);
+
+// --- CPU frame arenas ---
+void createFrameArenas(VulkanEngine* engine);
+void destroyFrameArenas(VulkanEngine* engine);
+// Resets the arenas of the given frame in flight. No job may still use them.
+void resetFrameArenas(uint32_t frame, VulkanEngine* engine);
+
+/**
+ * @brief Scratch memory of the current frame for the calling thread, which must be the
+ * render thread or a job system worker. Allocations stay valid until the frame slot
+ * comes around again; use it for per-frame std::pmr containers.
+ */
+FrameArena* getFrameArena(VulkanEngine* engine);
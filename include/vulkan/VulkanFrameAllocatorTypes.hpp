@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "VulkanBufferTypes.hpp"
+
+#include <cstdint>
+
+// Per-frame data handed out by the frame allocator; bind buffer with offset as a dynamic offset.
+struct FrameAllocation {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	uint32_t offset = 0;
+	void* data = nullptr;
+};
+
+/**
+ * @brief Persistently mapped buffer split into one region per frame in flight. Systems
+ * bump-allocate per-frame uniform and storage data from the current frame's region and
+ * bind it through dynamic offsets. A region is reset once its frame slot has been waited for.
+ */
+struct FrameAllocator {
+	AllocatedBuffer buffer;
+	uint8_t* mapped = nullptr;
+	VkDeviceSize regionSize = 0;
+	VkDeviceSize uniformAlignment = 0;
+	VkDeviceSize storageAlignment = 0;
+
+	uint32_t frame = 0;
+	VkDeviceSize head = 0;			// bytes used in the current frame's region
+	VkDeviceSize lastFrameUsage = 0;
+	VkDeviceSize peakUsage = 0;
+};
@@ -2,12 +2,9 @@
 
 #include "VulkanEngine.hpp"
 
-void createImage(uint32_t width, uint32_t height,
+AllocatedImage createImage(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers,
 		VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-		VkMemoryPropertyFlags properties, VkImage &image,
-		VkDeviceMemory &imageMemory, VulkanEngine *engine);
+		VulkanEngine *engine);
+void destroyImage(AllocatedImage& image, VulkanEngine *engine);
 
 void createImageViews(VulkanEngine* engine);
-void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VulkanEngine *engine);
-
-void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VulkanEngine *engine);
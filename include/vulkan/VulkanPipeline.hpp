@@ -3,5 +3,9 @@
 #include "VulkanEngine.hpp"
 
 void createGraphicsPipeline(VulkanEngine* engine);
+// The scene's pipeline state with other shaders, on a layout whose set 0 is descriptorSetLayout.
+// Instanced pipelines also consume InstanceData at binding 1.
+VkPipeline createScenePipeline(const char* vertexShaderPath, const char* fragmentShaderPath, bool instanced,
+	VkPipelineLayout layout, VulkanEngine* engine);
 VkShaderModule createShaderModule(const std::vector<char>& code, VulkanEngine* engine);
 static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
\ No newline at end of file
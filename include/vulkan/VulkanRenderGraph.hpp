@@ -0,0 +1,51 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+#include <functional>
+
+// Starts this frame's declarations; resources and passes from the previous frame become invalid.
+void beginRenderGraph(VulkanEngine* engine);
+
+// Images and buffers owned elsewhere, bound to this frame's handles.
+RenderGraphResource importGraphImage(const char* name, VkImage image, const VkImageSubresourceRange& range,
+		bool discard, VkPipelineStageFlags2 waitStages, VulkanEngine* engine);
+RenderGraphResource importGraphBuffer(const char* name, VkBuffer buffer, VulkanEngine* engine);
+// A declared transient image; the graph sets its pass range from the passes that use it.
+RenderGraphResource useGraphTransient(const char* name, TransientImageHandle handle, const VkImageSubresourceRange& range,
+		VulkanEngine* engine);
+
+/**
+ * @brief Declares a pass; record runs during executeRenderGraph with every barrier for the
+ * pass's uses already issued. Keep the callback's captures to a pointer or two so it
+ * fits std::function's inline storage.
+ */
+uint32_t addGraphPass(const char* name, bool sideEffects, std::function<void(VkCommandBuffer)> record, VulkanEngine* engine);
+void useGraphResource(uint32_t pass, RenderGraphResource resource, ResourceAccess access, VulkanEngine* engine);
+
+/**
+ * @brief Moves a compute-only pass to the async compute queue; the graph inserts timeline
+ * waits wherever it shares resources with graphics passes. Its resources must be usable
+ * from both families: buffers and images created with VK_SHARING_MODE_CONCURRENT over
+ * graphicsQueueFamily and computeQueueFamily, and no transient images.
+ */
+void setGraphPassQueue(uint32_t pass, RenderGraphQueue queue, VulkanEngine* engine);
+
+/**
+ * @brief Culls passes whose writes nothing reads and orders the rest. Consecutive passes on
+ * one queue form a submission. Transient images get the pass range of their first and last
+ * use, and are re-placed if that changed. Reuses the previous result while the declared
+ * topology is the same. The last pass has to run on the graphics queue.
+ */
+void compileRenderGraph(VulkanEngine* engine);
+
+// Issues one barrier batch in front of every compiled pass, then records it. The first graphics
+// submission is recorded into commandBuffer; the others get command buffers of their own.
+void executeRenderGraph(VkCommandBuffer commandBuffer, VulkanEngine* engine);
+
+/**
+ * @brief Submits the executed frame, one submission per queue switch. The first graphics
+ * submission waits for the swapchain acquire and pending uploads; the last one signals
+ * presentSemaphore and the frame's graphics timeline value.
+ */
+void submitRenderGraph(VkSemaphore acquireSemaphore, VkSemaphore presentSemaphore, VulkanEngine* engine);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "VulkanEngine.hpp"
+#include "VulkanBarrierTypes.hpp"
+#include "VulkanTransientTypes.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Index into RenderGraph::resources, valid for the frame that declared it.
+using RenderGraphResource = uint32_t;
+
+// AsyncCompute passes run on the compute queue when the device has a separate compute
+// family, and on the graphics queue like every other pass otherwise.
+enum class RenderGraphQueue : uint32_t {
+	Graphics,
+	AsyncCompute,
+};
+
+struct RenderGraphResourceInfo {
+	std::string name;
+	bool isBuffer = false;
+	// Transient images are placed by the graph; imported resources are bound every frame.
+	TransientImageHandle transient = UINT32_MAX;
+	VkImage image = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkImageSubresourceRange range{};
+	// Previous contents are not needed at the first use this frame.
+	bool discard = false;
+	// Stages a semaphore wait makes the first use wait for (the swapchain acquire).
+	VkPipelineStageFlags2 waitStages = VK_PIPELINE_STAGE_2_NONE;
+	bool used = false;	// touched by an executed pass this frame
+	RenderGraphQueue lastQueue = RenderGraphQueue::Graphics;	// of the last executed use this frame
+};
+
+struct RenderGraphUse {
+	RenderGraphResource resource;
+	ResourceAccess access;
+};
+
+struct RenderGraphPass {
+	std::string name;
+	std::vector<RenderGraphUse> uses;
+	// Passes with side effects (present, host readback) are never culled.
+	bool sideEffects = false;
+	RenderGraphQueue queue = RenderGraphQueue::Graphics;
+	std::function<void(VkCommandBuffer)> record;
+};
+
+/**
+ * @brief Consecutive compiled passes on one queue, recorded into one command buffer and
+ * submitted together. A batch only waits for the other queue where it shares resources
+ * with an earlier batch there, so independent work overlaps.
+ */
+struct RenderGraphBatch {
+	RenderGraphQueue queue = RenderGraphQueue::Graphics;
+	uint32_t firstPass = 0;		// index into RenderGraph::order
+	uint32_t passCount = 0;
+	// Batch on the other queue whose signal this one waits for; UINT32_MAX if none.
+	uint32_t waitBatch = UINT32_MAX;
+	// Compute batches that start using resources the previous frame's graphics work may still access.
+	bool waitPreviousFrame = false;
+
+	// Set while the frame is executed and submitted.
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	uint64_t signalValue = 0;
+};
+
+/**
+ * @brief Per-frame pass and resource declarations. Storage is reused between frames;
+ * only passCount and resourceCount entries are live. The compiled pass order and
+ * transient lifetimes are kept until the declared topology changes.
+ */
+struct RenderGraph {
+	std::vector<RenderGraphResourceInfo> resources;
+	std::vector<RenderGraphPass> passes;
+	uint32_t resourceCount = 0;
+	uint32_t passCount = 0;
+
+	uint64_t compiledTopology = 0;
+	std::vector<uint32_t> order;	// passes to execute, in declaration order
+	std::vector<RenderGraphBatch> batches;
+	uint32_t culledPasses = 0;
+	uint64_t compilations = 0;
+
+	// Primaries for every batch but the first graphics one, index [frame][queue]; reused once the slot is waited for.
+	std::array<std::array<std::vector<VkCommandBuffer>, 2>, MAX_FRAMES_IN_FLIGHT> batchCommandBuffers;
+	std::array<uint32_t, 2> batchCommandBuffersUsed{};
+};
@@ -2,5 +2,12 @@
 
 #include "VulkanEngine.hpp"
 
+VkFormat findDepthFormat(VulkanEngine* engine);
 void createRenderPass(VulkanEngine* engine);
-void createFramebuffers(VulkanEngine* engine);
\ No newline at end of file
+void destroyRenderPasses(VulkanEngine* engine);
+// Declares the transient attachments the render pass uses; createRenderPass must run first.
+void declareFrameAttachments(VulkanEngine* engine);
+void createFramebuffers(VulkanEngine* engine);
+// Re-places the transient images (after their pass ranges changed) and recreates the framebuffers using them.
+void rebuildFrameAttachments(VulkanEngine* engine);
+VkImageSubresourceRange depthRange(VulkanEngine* engine);
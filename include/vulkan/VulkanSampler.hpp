@@ -0,0 +1,15 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+namespace Assets { class GltfModel; }
+
+VkSamplerCreateInfo makeSamplerCreateInfo(VkFilter filter, VkSamplerMipmapMode mipmapMode, VkSamplerAddressMode addressMode);
+
+// Returns the sampler for this state, creating it on first use. The cache owns the
+// sampler; callers must not destroy it. pNext chains are not supported.
+VkSampler getSampler(const VkSamplerCreateInfo& samplerInfo, VulkanEngine* engine);
+void destroySamplerCache(VulkanEngine* engine);
+
+// Fills _vk.sceneSamplers from the model's glTF samplers. Must run before createModelTextures.
+void createModelSamplers(const Assets::GltfModel& model, VulkanEngine* engine);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+#include <vector>
+
+constexpr VkDeviceSize STAGING_RING_SIZE = 64ull * 1024 * 1024;
+
+void createStagingRing(VkDeviceSize size, VulkanEngine* engine);
+void destroyStagingRing(VulkanEngine* engine);
+
+/**
+ * @brief Reserves mapped staging memory for one upload. The space belongs to the next
+ * endSingleTimeCommands submission, so record the copies that read it before then.
+ * When the ring is full this waits only for the oldest in-flight submissions.
+ * Uploads larger than the ring get a one-off buffer with the same lifetime.
+ */
+StagingAllocation reserveStaging(VkDeviceSize size, VkDeviceSize alignment, VulkanEngine* engine);
+
+// Hands everything reserved since the previous submission to a submission that signals
+// timelineValue on the queue's timeline. Returns the submission's ticket for waitForUpload.
+uint64_t trackStagingSubmission(UploadQueue queue, uint64_t timelineValue, VkCommandBuffer commandBuffer, VulkanEngine* engine);
+
+// Recycles staging space and command buffers of finished submissions without blocking.
+void retireStaging(VulkanEngine* engine);
+
+bool isUploadComplete(uint64_t submission, VulkanEngine* engine);
+void waitForUpload(uint64_t submission, VulkanEngine* engine);
+
+// Stages at which frames wait on the transfer timeline: vertex fetch and texture reads.
+constexpr VkPipelineStageFlags2 UPLOAD_ACQUIRE_STAGES = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+
+// Makes the next frame wait for the given transfer submission (and all earlier ones)
+// instead of picking its resources up whenever the transfer happens to finish.
+void requireUpload(uint64_t submission, VulkanEngine* engine);
+
+/**
+ * @brief Records the graphics-side acquire barriers of transfer uploads that have finished
+ * or were required. Returns the transfer timeline value the frame's submission must wait
+ * for at UPLOAD_ACQUIRE_STAGES, or 0 when nothing was acquired. Resources of a transfer
+ * batch must not be used before a frame has acquired them.
+ */
+uint64_t recordUploadAcquires(VkCommandBuffer commandBuffer, VulkanEngine* engine);
+
+struct PendingImageCopy {
+	VkBuffer buffer;
+	VkImage image;
+	VkBufferImageCopy region;
+};
+
+/**
+ * @brief Records many uploads and layout transitions into one command buffer that is
+ * submitted once. Image copies are deferred to submission so all of their transitions
+ * go out as one barrier in front of the copies and one behind them. Only one batch should be staging data at a time, since staged space
+ * is tied to the next submission. If the staged data outgrows half the ring the batch
+ * submits what it has and continues in a fresh command buffer, so always re-read
+ * commandBuffer after stageUpload.
+ * Transfer batches on a dedicated family release what they write to the graphics family;
+ * frames pick the matching acquires up through recordUploadAcquires.
+ */
+struct UploadBatch {
+	UploadQueue queue = UploadQueue::Transfer;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkDeviceSize stagedBytes = 0;	// since the last submission of this batch
+	uint32_t submissionCount = 0;
+
+	BarrierBatch copyBarriers;
+	std::vector<PendingImageCopy> imageCopies;
+	// Transitions to shader reads and ownership releases, issued after every copy.
+	BarrierBatch finishBarriers;
+
+	// Acquire halves of ownership transfers recorded since the last submission.
+	std::vector<VkImageMemoryBarrier2> imageAcquires;
+	std::vector<VkBufferMemoryBarrier2> bufferAcquires;
+};
+
+UploadBatch beginUploadBatch(UploadQueue queue, VulkanEngine* engine);
+StagingAllocation stageUpload(UploadBatch& batch, VkDeviceSize size, VkDeviceSize alignment, VulkanEngine* engine);
+void uploadBuffer(UploadBatch& batch, const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset, VulkanEngine* engine);
+// Moves an image the batch copied into (TRANSFER_DST_OPTIMAL) to SHADER_READ_ONLY_OPTIMAL for
+// fragment shaders, releasing it to the graphics family when the batch runs on the transfer queue.
+// Recorded when the batch is submitted.
+void finishImageUpload(UploadBatch& batch, VkImage image, uint32_t mipLevels, uint32_t layerCount, VulkanEngine* engine);
+// Uploads tightly packed texels to mip 0 / layer 0 and leaves the image in SHADER_READ_ONLY_OPTIMAL.
+// The staged data is copied when the batch is submitted.
+void uploadImage(UploadBatch& batch, const void* pixels, VkDeviceSize size, VkImage image, VkFormat format,
+		uint32_t width, uint32_t height, VulkanEngine* engine);
+// Submits without waiting; returns the ticket to pass to waitForUpload.
+uint64_t submitUploadBatch(UploadBatch& batch, VulkanEngine* engine);
+
+constexpr uint32_t UPLOAD_BENCHMARK_BUFFERS = 10000;
+
+/**
+ * @brief Uploads bufferCount small vertex and index buffers through one transfer UploadBatch,
+ * waits for them and logs the time taken along with the ring's submissions and stalls.
+ * The buffers are destroyed once the frame that acquires them has finished.
+ */
+void runUploadBenchmark(uint32_t bufferCount, VulkanEngine* engine);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "VulkanBufferTypes.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Staging space handed out by the staging ring; copy from buffer at offset.
+struct StagingAllocation {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	void* data = nullptr;
+};
+
+// Queue an upload command buffer is submitted to. Transfer uploads run on a dedicated
+// transfer family when the device has one and fall back to the graphics queue otherwise.
+enum class UploadQueue {
+	Graphics,
+	Transfer,
+};
+
+struct StagingSubmission {
+	uint64_t end;		// ring position one past the last byte this submission reads
+	UploadQueue queue;
+	uint64_t timelineValue;	// reached on the queue's timeline when the submission completes
+	VkCommandBuffer commandBuffer;
+	std::vector<AllocatedBuffer> overflowBuffers;
+};
+
+/**
+ * @brief Queue family acquire barriers for resources a transfer submission released to
+ * the graphics family. The graphics queue records them in a frame that waits for
+ * timelineValue on the transfer timeline before using the resources.
+ */
+struct UploadAcquire {
+	uint64_t submission;
+	uint64_t timelineValue;
+	bool required = false;
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+};
+
+/**
+ * @brief Persistently mapped upload buffer used as a ring. Reserved space belongs to
+ * the next upload submission and is recycled once that submission's timeline value
+ * is reached. Positions are monotonic byte counters; the buffer offset is position % size.
+ */
+struct StagingRing {
+	AllocatedBuffer buffer;
+	VkDeviceSize size = 0;
+	uint8_t* mapped = nullptr;
+
+	uint64_t head = 0;	// next free position
+	uint64_t tail = 0;	// oldest position still read by an in-flight submission
+
+	// Submissions on both queues retire strictly in submission order, so a slow transfer
+	// only delays recycling, never frees space that is still being read.
+	std::deque<StagingSubmission> inFlight;	// oldest first
+	std::vector<AllocatedBuffer> pendingOverflow;	// one-off buffers for uploads larger than the ring
+
+	std::deque<UploadAcquire> pendingAcquires;	// oldest first
+
+	uint64_t bytesStaged = 0;
+	uint64_t submissions = 0;		// also the ticket of the latest submission
+	uint64_t completedSubmissions = 0;
+	uint64_t stalls = 0;
+	uint64_t overflowUploads = 0;
+	uint64_t acquireWaits = 0;		// frames that had to wait for a transfer still in flight
+};
@@ -6,7 +6,8 @@
 
 #include "VulkanEngine.hpp"
 
-void createSwapchain(VulkanEngine* engine);
+void createSwapchain(VulkanEngine* engine, VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+// Replaces the swapchain without waiting for the device; the old objects go through the deletion queue.
 void recreateSwapchain(VulkanEngine* engine);
 void cleanupSwapchain(VulkanEngine* engine);
 
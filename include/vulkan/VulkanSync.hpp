@@ -3,6 +3,26 @@
 #include "VulkanEngine.hpp"
 #include <stdexcept>
 
+// Timelines exist before the first upload and outlive the staging ring.
+void createQueueTimelines(VulkanEngine* engine);
+void destroyQueueTimelines(VulkanEngine* engine);
+
 void cleanupSyncObjects(VulkanEngine* engine);
 
-void createSyncObjects(VulkanEngine* engine);
\ No newline at end of file
+void createSyncObjects(VulkanEngine* engine);
+// Per swapchain image objects; recreated along with the swapchain.
+void createSwapchainSemaphores(VulkanEngine* engine);
+
+// Value the next submission to the queue signals; the timeline's value is advanced.
+uint64_t nextTimelineValue(QueueTimeline& timeline);
+
+/**
+ * @brief Frame pacing: blocks until the frame last submitted from the current slot,
+ * MAX_FRAMES_IN_FLIGHT frames ago, has finished on the GPU.
+ */
+void waitForFrameSlot(VulkanEngine* engine);
+// Numbers the frame about to be submitted and returns the graphics timeline value it signals.
+uint64_t beginFrameSubmission(VulkanEngine* engine);
+
+// Newest frame the GPU has finished; frames are numbered from 1, 0 means none yet.
+uint64_t getCompletedFrame(VulkanEngine* engine);
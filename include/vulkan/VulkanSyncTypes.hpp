@@ -0,0 +1,12 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// Timeline semaphore of one queue. Every submission to the queue signals the next value;
+// value is the last one submitted for signalling.
+struct QueueTimeline {
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	uint64_t value = 0;
+};
@@ -2,8 +2,31 @@
 
 #include "vulkan/VulkanEngine.hpp"
 #include <filesystem>
+#include <string>
 
-void createTextureImage(std::filesystem::path path, VulkanEngine *engine);
+namespace Assets { class GltfModel; }
+struct UploadBatch;
+
+void createTextureImage(std::filesystem::path path, UploadBatch& uploads, VulkanEngine *engine);
 void createTextureImageView(VulkanEngine *engine);
 VkImageView createImageView(VkImage image, VkFormat format, VulkanEngine *engine);
 void createTextureSampler(VulkanEngine *engine);
+
+// Uploads the model's decoded images: small ones are packed into atlases, the rest go
+// through the texture cache. Fills _vk.sceneTextures with one entry per glTF texture.
+void createModelTextures(const Assets::GltfModel& model, UploadBatch& uploads, VulkanEngine *engine);
+void destroyModelTextures(VulkanEngine *engine);
+
+// --- Texture cache ---
+// Different seeds give independent 64-bit hashes of the same bytes.
+uint64_t hashTextureContent(const void* data, size_t size, uint64_t seed = 0);
+
+// Returns the cached image for identical texels (tightly packed, 4 bytes per texel),
+// recording their upload into the batch on first use. Adds a reference.
+TextureHandle acquireTexture(const std::string& name, const void* pixels, uint32_t width, uint32_t height, VkFormat format,
+		UploadBatch& uploads, VulkanEngine *engine);
+const Scene::Image& getTexture(TextureHandle handle, VulkanEngine *engine);
+void retainTexture(TextureHandle handle, VulkanEngine *engine);
+// Drops a reference; the image is destroyed once nothing references it.
+void releaseTexture(TextureHandle handle, VulkanEngine *engine);
+void destroyTextureCache(VulkanEngine *engine);
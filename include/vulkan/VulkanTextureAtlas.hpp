@@ -0,0 +1,19 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+#include <string>
+#include <vector>
+
+struct UploadBatch;
+
+// Whether an image sampled with sampler can be packed: small enough, and clamped on both axes,
+// since repeating or mirroring coordinates would read the neighbouring atlas entries.
+bool isAtlasCandidate(uint32_t width, uint32_t height, const Scene::Sampler& sampler);
+
+// Queues tightly packed RGBA8 texels for packing. Returns the index of the texture's region in the build result.
+uint32_t addAtlasTexture(TextureAtlasBuilder& builder, const std::string& name, const void* pixels,
+		uint32_t width, uint32_t height, VkFormat format);
+
+// Packs all queued textures into one 2D array image per format and records their upload. Clears the builder.
+std::vector<AtlasRegion> buildTextureAtlases(TextureAtlasBuilder& builder, UploadBatch& uploads, VulkanEngine* engine);
+void destroyTextureAtlases(VulkanEngine* engine);
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Assets/SceneTypes.hpp"
+
+using TextureHandle = uint32_t;
+constexpr TextureHandle INVALID_TEXTURE_HANDLE = UINT32_MAX;
+
+/**
+ * @brief Identity of an uploaded image: what the texels are and how they are stored.
+ * Sampler state is deliberately not part of the key; Scene::Texture pairs a shared
+ * image with its own sampler. A hit is trusted without comparing texels, so the content
+ * hash is 128 bits: two independently seeded passes of hashTextureContent.
+ */
+struct TextureKey {
+	std::array<uint64_t, 2> contentHash;
+	uint32_t width;
+	uint32_t height;
+	VkFormat format;
+	uint32_t mipLevels;
+
+	bool operator==(const TextureKey&) const = default;
+};
+
+struct TextureKeyHash {
+	size_t operator()(const TextureKey& key) const
+	{
+		// Either half is already well mixed; the other only matters for equality.
+		uint64_t hash = key.contentHash[0];
+		hash ^= (static_cast<uint64_t>(key.width) << 32 | key.height) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+		hash ^= (static_cast<uint64_t>(key.format) << 32 | key.mipLevels) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+		return static_cast<size_t>(hash);
+	}
+};
+
+struct TextureCacheEntry {
+	TextureKey key;
+	Scene::Image image;
+	uint32_t refCount = 0;
+};
+
+/**
+ * @brief Content-addressed registry of uploaded images. Identical texels uploaded
+ * from different models resolve to one Scene::Image that lives until the last
+ * reference is released.
+ */
+struct TextureCache {
+	std::unordered_map<TextureKey, TextureHandle, TextureKeyHash> lookup;
+	std::vector<TextureCacheEntry> entries;
+	std::vector<TextureHandle> freeHandles;
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+};
+
+// Textures no larger than this in either dimension are packed into shared atlas layers.
+constexpr uint32_t ATLAS_MAX_TEXTURE_SIZE = 256;
+constexpr uint32_t ATLAS_LAYER_SIZE = 1024;
+// Gutter of replicated edge texels around each packed texture so bilinear filtering does not bleed.
+constexpr uint32_t ATLAS_PADDING = 4;
+
+/**
+ * @brief 2D array image whose layers are shelf-packed with small textures of one format.
+ */
+struct TextureAtlas {
+	VkFormat format;
+	uint32_t layerCount = 0;
+	uint32_t textureCount = 0;
+	AllocatedImage image;
+	VkImageView view = VK_NULL_HANDLE;
+};
+
+// Where a packed texture ended up: sample layer `layer` of atlas `atlas` at uvOffset + uv * uvScale.
+struct AtlasRegion {
+	uint32_t atlas;
+	uint32_t layer;
+	glm::vec2 uvOffset;
+	glm::vec2 uvScale;
+};
+
+struct PendingAtlasTexture {
+	std::string name;
+	uint32_t width;
+	uint32_t height;
+	VkFormat format;
+	std::vector<uint8_t> pixels;
+};
+
+// Collects small textures during import so they can be packed and uploaded together.
+struct TextureAtlasBuilder {
+	std::vector<PendingAtlasTexture> pending;
+};
+
+/**
+ * @brief Sampler state that identifies a cached VkSampler: every VkSamplerCreateInfo
+ * field except sType, pNext and flags.
+ */
+struct SamplerKey {
+	VkFilter magFilter;
+	VkFilter minFilter;
+	VkSamplerMipmapMode mipmapMode;
+	VkSamplerAddressMode addressModeU;
+	VkSamplerAddressMode addressModeV;
+	VkSamplerAddressMode addressModeW;
+	float mipLodBias;
+	VkBool32 anisotropyEnable;
+	float maxAnisotropy;
+	VkBool32 compareEnable;
+	VkCompareOp compareOp;
+	float minLod;
+	float maxLod;
+	VkBorderColor borderColor;
+	VkBool32 unnormalizedCoordinates;
+
+	bool operator==(const SamplerKey&) const = default;
+};
+
+struct SamplerKeyHash {
+	size_t operator()(const SamplerKey& key) const
+	{
+		// -0.0f compares equal to 0.0f, so it has to hash the same.
+		auto bits = [](float value) { return value == 0.0f ? 0u : std::bit_cast<uint32_t>(value); };
+		const uint64_t fields[] = {
+			static_cast<uint64_t>(key.magFilter) | static_cast<uint64_t>(key.minFilter) << 8 | static_cast<uint64_t>(key.mipmapMode) << 16
+				| static_cast<uint64_t>(key.addressModeU) << 24 | static_cast<uint64_t>(key.addressModeV) << 32
+				| static_cast<uint64_t>(key.addressModeW) << 40 | static_cast<uint64_t>(key.compareOp) << 48,
+			static_cast<uint64_t>(bits(key.mipLodBias)) << 32 | bits(key.maxAnisotropy),
+			static_cast<uint64_t>(bits(key.minLod)) << 32 | bits(key.maxLod),
+			static_cast<uint64_t>(key.borderColor) << 8 | key.anisotropyEnable << 2 | key.compareEnable << 1 | key.unnormalizedCoordinates,
+		};
+
+		uint64_t hash = 0;
+		for (uint64_t field : fields) {
+			hash ^= field + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+		}
+		return static_cast<size_t>(hash);
+	}
+};
+
+/**
+ * @brief Shared VkSampler objects keyed by their state. Drivers cap the number of
+ * live samplers, and most materials only need a handful of distinct ones. Samplers
+ * live until the cache is destroyed.
+ */
+struct SamplerCache {
+	std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> samplers;
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+// Declares a frame-local render target; call before buildTransientImages.
+TransientImageHandle declareTransientImage(const TransientImageDesc& desc, VulkanEngine* engine);
+
+/**
+ * @brief Creates every declared image at the current swapchain extent. Attachment-only
+ * images use lazily allocated memory where the device has it; the rest are grouped so
+ * images with disjoint pass ranges alias the same allocation.
+ */
+void buildTransientImages(VulkanEngine* engine);
+// Hands the images and their memory to the deletion queue; the declarations are kept.
+void releaseTransientImages(VulkanEngine* engine);
+
+VkImage getTransientImage(TransientImageHandle handle, VulkanEngine* engine);
+VkImageView getTransientImageView(TransientImageHandle handle, VulkanEngine* engine);
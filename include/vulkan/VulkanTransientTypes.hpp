@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "vk_mem_alloc.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Index into TransientImages::images.
+using TransientImageHandle = uint32_t;
+
+/**
+ * @brief Render target that only lives within a frame. Passes are numbered in frame
+ * order; images whose [firstPass, lastPass] ranges do not overlap may share memory.
+ */
+struct TransientImageDesc {
+	std::string name;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkImageUsageFlags usage = 0;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	// 0 follows the swapchain extent.
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t firstPass = 0;
+	uint32_t lastPass = 0;
+};
+
+struct TransientImage {
+	TransientImageDesc desc;
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	VkMemoryRequirements requirements{};
+	// Lazily allocated images own their allocation; aliased ones share one of TransientImages::allocations.
+	VmaAllocation lazyAllocation = VK_NULL_HANDLE;
+	uint32_t aliasGroup = UINT32_MAX;
+};
+
+struct TransientImages {
+	std::vector<TransientImage> images;
+	std::vector<VmaAllocation> allocations;	// one per alias group
+
+	VkDeviceSize unaliasedBytes = 0;	// sum of every image that is not lazily allocated
+	VkDeviceSize aliasedBytes = 0;		// what the alias groups actually allocate
+	uint32_t lazyImages = 0;
+};
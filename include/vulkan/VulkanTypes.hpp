@@ -23,7 +23,7 @@ struct Vertex {
 
         attributeDescriptions[0].binding = 0;
         attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
         attributeDescriptions[0].offset = offsetof(Vertex, position);
 
         attributeDescriptions[1].binding = 0;
@@ -70,3 +70,17 @@ struct InstanceData {
 		return attributeDescriptions;
 	}
 };
+
+/**
+ * @brief Per-object data of the GPU-driven path, read by cull.comp and indirect.vert.
+ * Matches GpuObject in shaders/gpu_object.glsl (std430).
+ */
+struct GpuObject {
+	alignas(16) glm::mat4 model;
+	alignas(16) glm::vec4 sphere;	// object space bounding sphere: center, radius
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t padding;
+};
+static_assert(sizeof(GpuObject) == 96, "GpuObject must match the std430 layout");
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "VulkanEngine.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Descriptor set index the virtual texture bindings are expected at (see shaders/virtual_texture.glsl).
+constexpr uint32_t VIRTUAL_TEXTURE_SET = 1;
+
+// Feedback entries that were not written by any fragment this frame.
+constexpr uint32_t VIRTUAL_TEXTURE_NO_REQUEST = 0xFFFFFFFFu;
+
+/**
+ * @brief Fills one physical tile (pageSize + 2 * pageBorder texels per side, RGBA8)
+ * for the virtual page (x, y) at the given mip. The border must contain the
+ * neighbouring texels of the source so bilinear filtering does not bleed.
+ */
+using VirtualTexturePageProvider = std::function<void(uint32_t x, uint32_t y, uint32_t mip, uint8_t* texels, uint32_t tileSize)>;
+
+struct VirtualTextureCreateInfo {
+	std::string name;
+	uint32_t widthInPages = 64;
+	uint32_t heightInPages = 64;
+	uint32_t pageSize = 128;
+	uint32_t pageBorder = 4;
+	uint32_t physicalPagesPerSide = 24;
+	uint32_t feedbackScale = 8;
+	uint32_t maxPageLoadsPerUpdate = 16;
+	VirtualTexturePageProvider provider;
+};
+
+struct VirtualTexturePageLoad {
+	uint32_t slot;
+	uint32_t pageId;
+	std::vector<uint8_t> texels;
+};
+
+struct VirtualTexturePageTableRegion {
+	uint32_t mip;
+	uint32_t x, y, width, height;
+	std::vector<uint32_t> entries;
+};
+
+struct VirtualTextureParams {
+	alignas(16) glm::vec4 virtualSize;	// x, y: pages at mip 0, z: page size, w: mip count
+	alignas(16) glm::vec4 physicalSize;	// x: tile size, y: page border, z: atlas size in texels
+	alignas(16) glm::uvec4 feedback;	// x, y: feedback extent, z: feedback scale, w: jitter index
+};
+
+/**
+ * @brief Software-indirected virtual texture. A page table image (one mip per
+ * virtual mip) maps virtual pages onto tiles of a physical cache atlas. The
+ * fragment shader writes requested page IDs into a low-resolution feedback
+ * buffer; a worker thread resolves those requests into page loads and evicts
+ * the least recently requested tiles when the cache is full.
+ */
+struct VirtualTexture {
+	VirtualTextureCreateInfo info;
+	uint32_t mipCount = 1;
+	uint32_t tileSize = 0;
+	uint32_t atlasSize = 0;
+
+	AllocatedImage pageTableImage;
+	VkImageView pageTableView = VK_NULL_HANDLE;
+
+	AllocatedImage atlasImage;
+	VkImageView atlasView = VK_NULL_HANDLE;
+
+	// Owned by the sampler cache; immutable samplers of the descriptor set layout.
+	VkSampler pageTableSampler = VK_NULL_HANDLE;
+	VkSampler atlasSampler = VK_NULL_HANDLE;
+
+	uint32_t feedbackWidth = 0;
+	uint32_t feedbackHeight = 0;
+	std::vector<AllocatedBuffer> feedbackBuffers;
+	std::vector<uint32_t*> feedbackMapped;
+
+	std::vector<AllocatedBuffer> paramBuffers;
+	std::vector<void*> paramMapped;
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> descriptorSets;
+
+	// The scene pipeline with shaders/virtual_texture.frag: set 0 is the scene's, set
+	// VIRTUAL_TEXTURE_SET this texture's.
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	uint32_t frameJitter = 0;
+
+	// --- Worker-owned residency state ---
+	struct Slot {
+		uint32_t pageId = VIRTUAL_TEXTURE_NO_REQUEST;
+		bool pinned = false;
+		uint64_t lastRequestBatch = 0;
+		std::list<uint32_t>::iterator lruPosition;
+	};
+	uint64_t requestBatch = 0;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::list<uint32_t> lru;			// front = most recently requested
+	std::vector<std::vector<int32_t>> residency;	// per mip, slot index or -1
+	std::vector<std::vector<uint32_t>> pageTable;	// per mip, packed RGBA8 entries
+
+	// --- Shared between the render thread and the worker ---
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopRequested = false;
+	std::vector<uint32_t> pendingRequests;
+	std::vector<VirtualTexturePageLoad> completedLoads;
+	std::vector<VirtualTexturePageTableRegion> completedRegions;
+};
+
+VirtualTexture* createVirtualTexture(const VirtualTextureCreateInfo& createInfo, VulkanEngine* engine);
+void destroyVirtualTexture(VirtualTexture* texture, VulkanEngine* engine);
+
+// Reads back the feedback written by the frame that last used this frame slot and hands it to the worker.
+void collectVirtualTextureFeedback(VirtualTexture* texture, uint32_t currentFrame, VulkanEngine* engine);
+
+// Uploads pages and page table changes the worker has finished since the last call.
+void updateVirtualTexture(VirtualTexture* texture, VulkanEngine* engine);
+
+uint32_t packVirtualTexturePageId(uint32_t x, uint32_t y, uint32_t mip);
+
+// Generates the pages of a createInfo-sized texture on the worker: a checkerboard with page
+// outlines, tinted per mip so the streamed level can be told apart on screen.
+VirtualTexturePageProvider makeProceduralPageProvider(const VirtualTextureCreateInfo& createInfo);
@@ -0,0 +1,9 @@
+// Per-object data of the GPU-driven path; matches GpuObject in VulkanTypes.hpp (std430).
+struct GpuObject {
+	mat4 model;
+	vec4 sphere;		// object space bounding sphere: center, radius
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint padding;
+};
@@ -0,0 +1,31 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// shader.vert for the GPU-driven path: the transform comes from the object the culling
+// pass stored in firstInstance, the camera from the frame's single uniform buffer.
+
+#include "gpu_object.glsl"
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+layout(std430, set = 0, binding = 2) readonly buffer Objects {
+	GpuObject objects[];
+};
+
+void main() {
+	mat4 model = objects[gl_InstanceIndex].model;
+	gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
+	fragColor = inColor;
+	fragTexCoord = inTexCoord;
+}
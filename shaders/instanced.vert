@@ -0,0 +1,24 @@
+#version 450
+
+// shader.vert for the instanced path: the transform comes from the InstanceData at binding 1,
+// the camera from the uniforms every instance of the draw shares.
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in mat4 inModel;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+void main() {
+	gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0);
+	fragColor = inColor;
+	fragTexCoord = inTexCoord;
+}
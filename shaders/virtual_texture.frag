@@ -0,0 +1,20 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// shader.frag for a scene drawn with a virtual texture: the texel comes through the page
+// table, and the page it wanted goes into the feedback buffer.
+
+#include "virtual_texture.glsl"
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	// Derivatives need every fragment of the quad and must not see the wrap seams, so the
+	// mip comes from the unwrapped coordinates before anything branches.
+	float lod = vtMipLevel(fragTexCoord);
+	vtWriteFeedback(fragTexCoord, lod);
+	outColor = vtSample(fragTexCoord, lod);
+}
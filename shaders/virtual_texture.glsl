@@ -0,0 +1,68 @@
+// Virtual texture sampling and feedback, included by fragment shaders that use a
+// VirtualTexture. Define VT_SET before including to override the descriptor set.
+// Texture coordinates repeat outside [0, 1).
+#ifndef VT_SET
+#define VT_SET 1
+#endif
+
+layout(set = VT_SET, binding = 0) uniform usampler2D vtPageTable;
+layout(set = VT_SET, binding = 1) uniform sampler2D vtPhysicalCache;
+
+layout(set = VT_SET, binding = 2) buffer VirtualTextureFeedback {
+	uint requests[];
+} vtFeedback;
+
+layout(set = VT_SET, binding = 3) uniform VirtualTextureParams {
+	vec4 virtualSize;	// x, y: pages at mip 0, z: page size, w: mip count
+	vec4 physicalSize;	// x: tile size, y: page border, z: atlas size in texels
+	uvec4 feedback;		// x, y: feedback extent, z: feedback scale, w: jitter index
+} vt;
+
+// The mip the sample needs, from the derivatives of the unwrapped coordinates. Call it in
+// uniform control flow, once per fragment, and hand the result to vtSample and vtWriteFeedback.
+float vtMipLevel(vec2 uv)
+{
+	vec2 texels = uv * vt.virtualSize.xy * vt.virtualSize.z;
+	vec2 dx = dFdx(texels);
+	vec2 dy = dFdy(texels);
+	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+	return clamp(lod, 0.0, vt.virtualSize.w - 1.0);
+}
+
+uvec2 vtPagesAtMip(uint mip)
+{
+	return max(uvec2(vt.virtualSize.xy) >> mip, uvec2(1));
+}
+
+// uv may lie outside [0, 1); the texture repeats.
+vec4 vtSample(vec2 uv, float lod)
+{
+	uv = fract(uv);
+	uint mip = uint(lod);
+	uvec2 cell = min(uvec2(uv * vec2(vtPagesAtMip(mip))), vtPagesAtMip(mip) - 1);
+	uvec4 entry = texelFetch(vtPageTable, ivec2(cell), int(mip));
+
+	// The entry may point at a coarser resident page; locate uv inside that page.
+	vec2 pageUV = fract(uv * vec2(vtPagesAtMip(entry.b)));
+	vec2 texel = vec2(entry.rg) * vt.physicalSize.x + vt.physicalSize.y + pageUV * vt.virtualSize.z;
+	return textureLod(vtPhysicalCache, texel / vt.physicalSize.z, 0.0);
+}
+
+void vtWriteFeedback(vec2 uv, float lod)
+{
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	uint scale = vt.feedback.z;
+	uint jitter = vt.feedback.w;
+	if (pixel.x % scale != jitter % scale || pixel.y % scale != jitter / scale) {
+		return;
+	}
+
+	uvec2 target = pixel / scale;
+	if (target.x >= vt.feedback.x || target.y >= vt.feedback.y) {
+		return;
+	}
+
+	uint mip = uint(lod);
+	uvec2 page = min(uvec2(fract(uv) * vec2(vtPagesAtMip(mip))), vtPagesAtMip(mip) - 1);
+	vtFeedback.requests[target.y * vt.feedback.x + target.x] = (mip << 28) | (page.y << 14) | page.x;
+}
@@ -1,15 +1,21 @@
 #include "Assets/GltfLoader.hpp"
 #include "fastgltf/core.hpp"
 
-#define VMA_IMPLEMENTATION
-#include <vk_mem_alloc.h>
+#include "FileIO.hpp"
+#include "JobSystem.hpp"
+#include "Logger.hpp"
 
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 
 namespace Assets {
 
 	GltfModel::GltfModel() = default;
+	GltfModel::GltfModel(std::filesystem::path filepath) : m_Filepath(std::move(filepath)) {}
 	GltfModel::~GltfModel() = default;
 
 	bool GltfModel::Load(int const sceneID)
@@ -169,6 +175,106 @@ namespace Assets {
 	}
 
 
+	ImageDecodeStats GltfModel::DecodeImages(JobSystem& jobs)
+	{
+		using Clock = std::chrono::steady_clock;
+		const auto wallStart = Clock::now();
+
+		const size_t imageCount = m_GltfAsset.images.size();
+		m_Images.clear();
+		m_Images.resize(imageCount);
+
+		jobs.ParallelFor(static_cast<uint32_t>(imageCount), [&](uint32_t imageIndex) {
+			const auto& gltfImage = m_GltfAsset.images[imageIndex];
+			DecodedImage& decoded = m_Images[imageIndex];
+			decoded.name = gltfImage.name.empty()
+				? m_Filepath.stem().string() + "#image" + std::to_string(imageIndex)
+				: std::string(gltfImage.name);
+
+			// An image that cannot be read or decoded stays empty; the textures using it are skipped.
+			const auto start = Clock::now();
+			std::vector<uint8_t> encoded;
+			try {
+				encoded = ReadImageSource(gltfImage);
+			} catch (const std::exception& e) {
+				Logger::Warn("Skipping image " + decoded.name + ": " + e.what());
+				return;
+			}
+			decoded.encodedBytes = encoded.size();
+
+			int width = 0, height = 0, channels = 0;
+			stbi_uc* pixels = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()),
+				&width, &height, &channels, STBI_rgb_alpha);
+			if (!pixels) {
+				Logger::Warn("Skipping image " + decoded.name + ", failed to decode: " + stbi_failure_reason());
+				return;
+			}
+
+			decoded.width = static_cast<uint32_t>(width);
+			decoded.height = static_cast<uint32_t>(height);
+			decoded.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+			stbi_image_free(pixels);
+
+			decoded.decodeMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		});
+
+		ImageDecodeStats stats{};
+		stats.imageCount = imageCount;
+		stats.wallMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - wallStart).count();
+		for (const DecodedImage& image : m_Images) {
+			stats.encodedBytes += image.encodedBytes;
+			stats.decodedBytes += image.pixels.size();
+			stats.totalImageMilliseconds += image.decodeMilliseconds;
+			stats.maxImageMilliseconds = std::max(stats.maxImageMilliseconds, image.decodeMilliseconds);
+			stats.minImageMilliseconds = stats.minImageMilliseconds == 0.0
+				? image.decodeMilliseconds
+				: std::min(stats.minImageMilliseconds, image.decodeMilliseconds);
+		}
+		return stats;
+	}
+
+	std::vector<uint8_t> GltfModel::ReadImageSource(const fastgltf::Image& image) const
+	{
+		auto copyBytes = [](const auto& bytes, size_t offset, size_t length) {
+			const auto* begin = reinterpret_cast<const uint8_t*>(bytes.data()) + offset;
+			return std::vector<uint8_t>(begin, begin + length);
+		};
+
+		return std::visit(fastgltf::visitor{
+			[&](const fastgltf::sources::Array& array) {
+				return copyBytes(array.bytes, 0, array.bytes.size());
+			},
+			[&](const fastgltf::sources::Vector& vector) {
+				return copyBytes(vector.bytes, 0, vector.bytes.size());
+			},
+			[&](const fastgltf::sources::BufferView& view) {
+				const auto& bufferView = m_GltfAsset.bufferViews[view.bufferViewIndex];
+				const auto& buffer = m_GltfAsset.buffers[bufferView.bufferIndex];
+				return std::visit(fastgltf::visitor{
+					[&](const fastgltf::sources::Array& array) {
+						return copyBytes(array.bytes, bufferView.byteOffset, bufferView.byteLength);
+					},
+					[&](const fastgltf::sources::Vector& vector) {
+						return copyBytes(vector.bytes, bufferView.byteOffset, bufferView.byteLength);
+					},
+					[&](const auto&) -> std::vector<uint8_t> {
+						throw std::runtime_error("Unsupported buffer source type for image");
+					}
+				}, buffer.data);
+			},
+			[&](const fastgltf::sources::URI& uri) {
+				if (uri.fileByteOffset != 0 || !uri.uri.isLocalPath()) {
+					throw std::runtime_error("Unsupported image URI");
+				}
+				std::vector<char> file = read_file_binary(m_Filepath.parent_path() / uri.uri.fspath());
+				return copyBytes(file, 0, file.size());
+			},
+			[&](const auto&) -> std::vector<uint8_t> {
+				throw std::runtime_error("Unsupported image source type");
+			}
+		}, image.data);
+	}
+
 	Float3 GltfModel::ConvertToFloat3(const glm::vec3& vec)
 	{
 		return {vec.x, vec.y, vec.z};
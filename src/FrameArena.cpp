@@ -0,0 +1,131 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	// Trivially initialised, so it is safe to touch from operator new on any thread.
+	thread_local uint64_t threadHeapAllocations = 0;
+
+	size_t alignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+FrameArena::FrameArena(size_t blockSize)
+	: m_BlockSize(blockSize)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	for (const Block& block : m_Blocks) {
+		::operator delete(block.data, std::align_val_t{alignof(std::max_align_t)});
+	}
+}
+
+void FrameArena::Reset()
+{
+	if (m_Current > 0) {
+		// Last frame spilled into extra blocks; replace them with one that fits it all.
+		size_t total = GetCapacity();
+		for (const Block& block : m_Blocks) {
+			::operator delete(block.data, std::align_val_t{alignof(std::max_align_t)});
+		}
+		m_Blocks.clear();
+		AddBlock(total);
+	}
+
+	m_Current = 0;
+	m_Offset = 0;
+	m_BytesUsed = 0;
+}
+
+size_t FrameArena::GetCapacity() const
+{
+	size_t capacity = 0;
+	for (const Block& block : m_Blocks) {
+		capacity += block.size;
+	}
+	return capacity;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+	if (!m_Blocks.empty()) {
+		Block& block = m_Blocks[m_Current];
+		uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+		size_t start = alignUp(base + m_Offset, alignment) - base;
+		if (start + bytes <= block.size) {
+			m_Offset = start + bytes;
+			m_BytesUsed += bytes;
+			m_PeakBytesUsed = std::max(m_PeakBytesUsed, m_BytesUsed);
+			return block.data + start;
+		}
+	}
+
+	AddBlock(bytes + alignment);
+	m_Current = m_Blocks.size() - 1;
+	m_Offset = 0;
+	return do_allocate(bytes, alignment);
+}
+
+void FrameArena::AddBlock(size_t minimumSize)
+{
+	size_t size = std::max(m_BlockSize, minimumSize);
+	if (!m_Blocks.empty()) {
+		size = std::max(size, m_Blocks.back().size * 2);
+	}
+
+	auto* data = static_cast<std::byte*>(::operator new(size, std::align_val_t{alignof(std::max_align_t)}));
+	m_Blocks.push_back({data, size});
+	m_BlockAllocations++;
+}
+
+uint64_t GetThreadHeapAllocationCount()
+{
+	return threadHeapAllocations;
+}
+
+// Counting replacements of the global allocation functions. The aligned, nothrow and
+// sized forms forward to these by default, except the aligned pair below.
+void* operator new(size_t size)
+{
+	threadHeapAllocations++;
+	if (void* p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	threadHeapAllocations++;
+	size_t align = static_cast<size_t>(alignment);
+	if (void* p = std::aligned_alloc(align, alignUp(size ? size : 1, align))) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+	std::free(p);
+}
@@ -0,0 +1,124 @@
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <latch>
+
+namespace {
+	thread_local uint32_t currentThreadIndex = 0;
+}
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+		threadCount = std::max(1u, threadCount);
+	}
+
+	m_Workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		m_Workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_WakeWorkers.notify_all();
+	for (auto& worker : m_Workers) {
+		worker.join();
+	}
+}
+
+void JobSystem::Dispatch(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.push_back(std::move(job));
+	}
+	m_WakeWorkers.notify_one();
+}
+
+void JobSystem::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+{
+	if (count == 0) {
+		return;
+	}
+
+	std::atomic<uint32_t> next{0};
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto drain = [&] {
+		for (uint32_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+			try {
+				job(i);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+	};
+
+	uint32_t helpers = std::min<uint32_t>(GetThreadCount(), count - 1);
+	std::latch done(helpers);
+	for (uint32_t i = 0; i < helpers; ++i) {
+		Dispatch([&] {
+			drain();
+			done.count_down();
+		});
+	}
+
+	drain();
+	done.wait();
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+void JobSystem::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Idle.wait(lock, [this] { return m_Queue.empty() && m_Running == 0; });
+}
+
+uint32_t JobSystem::GetCurrentThreadIndex()
+{
+	return currentThreadIndex;
+}
+
+void JobSystem::WorkerLoop(uint32_t index)
+{
+	currentThreadIndex = index;
+
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeWorkers.wait(lock, [this] { return m_Stop || !m_Queue.empty(); });
+			if (m_Stop && m_Queue.empty()) {
+				return;
+			}
+			job = std::move(m_Queue.front());
+			m_Queue.pop_front();
+			m_Running++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Running--;
+			if (m_Queue.empty() && m_Running == 0) {
+				m_Idle.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanAllocator.hpp"
+#include "Logger.hpp"
+
+#define VMA_IMPLEMENTATION
+#include <vk_mem_alloc.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+void createAllocator(VulkanEngine* engine)
+{
+	VmaAllocatorCreateInfo allocatorInfo{};
+	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+	allocatorInfo.instance = engine->_vk.instance;
+	allocatorInfo.physicalDevice = engine->_vk.physicalDevice;
+	allocatorInfo.device = engine->_vk.device;
+	if (engine->_vk.memoryBudget.extensionEnabled) {
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+	}
+
+	if (vmaCreateAllocator(&allocatorInfo, &engine->_vk.allocator) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create memory allocator!");
+	}
+
+	if (!engine->_vk.memoryBudget.extensionEnabled) {
+		Logger::Warn("VK_EXT_memory_budget not available; memory budgets are estimates from our own allocations");
+	}
+}
+
+void destroyAllocator(VulkanEngine* engine)
+{
+	logAllocatorStats(engine);
+	vmaDestroyAllocator(engine->_vk.allocator);
+	engine->_vk.allocator = VK_NULL_HANDLE;
+}
+
+void logAllocatorStats(VulkanEngine* engine)
+{
+	VmaTotalStatistics stats{};
+	vmaCalculateStatistics(engine->_vk.allocator, &stats);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(engine->_vk.physicalDevice, &properties);
+
+	constexpr double MiB = 1024.0 * 1024.0;
+	const VmaStatistics& total = stats.total.statistics;
+	Logger::Info("Allocator: " + std::to_string(total.allocationCount) + " allocations in "
+		+ std::to_string(total.blockCount) + " device memory objects (limit "
+		+ std::to_string(properties.limits.maxMemoryAllocationCount) + "), "
+		+ std::to_string(total.allocationBytes / MiB) + " MiB used of "
+		+ std::to_string(total.blockBytes / MiB) + " MiB reserved");
+
+	const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+	vmaGetMemoryProperties(engine->_vk.allocator, &memoryProperties);
+	std::vector<VmaBudget> budgets(memoryProperties->memoryHeapCount);
+	vmaGetHeapBudgets(engine->_vk.allocator, budgets.data());
+	for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i) {
+		bool deviceLocal = memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+		Logger::Info("Heap " + std::to_string(i) + (deviceLocal ? " (device)" : " (host)") + ": "
+			+ std::to_string(static_cast<uint64_t>(budgets[i].usage / MiB)) + " / "
+			+ std::to_string(static_cast<uint64_t>(budgets[i].budget / MiB)) + " MiB budget"
+			+ (engine->_vk.memoryBudget.extensionEnabled ? "" : " (estimated)"));
+	}
+}
+
+void updateMemoryBudget(VulkanEngine* engine)
+{
+	MemoryBudget& budget = engine->_vk.memoryBudget;
+	// Lets VMA refresh the driver's budget numbers once per frame instead of per query.
+	vmaSetCurrentFrameIndex(engine->_vk.allocator, ++budget.frameIndex);
+
+	const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+	vmaGetMemoryProperties(engine->_vk.allocator, &memoryProperties);
+	budget.heaps.resize(memoryProperties->memoryHeapCount);
+	budget.heapFlags.resize(memoryProperties->memoryHeapCount);
+	vmaGetHeapBudgets(engine->_vk.allocator, budget.heaps.data());
+
+	VkDeviceSize bytesToFree = 0;
+	bool overThreshold = false;
+	for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i) {
+		budget.heapFlags[i] = memoryProperties->memoryHeaps[i].flags;
+		if (!(budget.heapFlags[i] & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+			continue;
+		}
+
+		const VmaBudget& heap = budget.heaps[i];
+		if (heap.usage > heap.budget * MEMORY_PRESSURE_THRESHOLD) {
+			overThreshold = true;
+			bytesToFree += heap.usage - static_cast<VkDeviceSize>(heap.budget * MEMORY_PRESSURE_TARGET);
+		}
+	}
+
+	if (overThreshold && !budget.underPressure) {
+		budget.pressureEvents++;
+		Logger::Warn("Device memory usage above " + std::to_string(static_cast<int>(MEMORY_PRESSURE_THRESHOLD * 100))
+			+ "% of budget; asking for " + std::to_string(bytesToFree / (1024 * 1024)) + " MiB back");
+	}
+	budget.underPressure = overThreshold;
+
+	for (auto& [id, handler] : budget.handlers) {
+		if (bytesToFree == 0) {
+			break;
+		}
+		bytesToFree -= std::min(bytesToFree, handler(bytesToFree));
+	}
+}
+
+uint32_t registerMemoryPressureHandler(MemoryPressureHandler handler, VulkanEngine* engine)
+{
+	MemoryBudget& budget = engine->_vk.memoryBudget;
+	uint32_t id = budget.nextHandlerId++;
+	budget.handlers.emplace_back(id, std::move(handler));
+	return id;
+}
+
+void unregisterMemoryPressureHandler(uint32_t id, VulkanEngine* engine)
+{
+	auto& handlers = engine->_vk.memoryBudget.handlers;
+	std::erase_if(handlers, [id](const auto& entry) { return entry.first == id; });
+}
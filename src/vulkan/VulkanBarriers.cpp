@@ -0,0 +1,247 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+
+namespace {
+
+	VkImageMemoryBarrier2 makeImageBarrier(VkImage image, const VkImageSubresourceRange& range,
+			VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkImageLayout oldLayout, const ResourceAccessInfo& dst)
+	{
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = srcStages;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstStageMask = dst.stages;
+		barrier.dstAccessMask = dst.access;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = dst.layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = range;
+		return barrier;
+	}
+
+	// A read of the same image at another stage joins the barrier already collected for it.
+	bool mergeRead(BarrierBatch& batch, VkImage image, const ResourceAccessInfo& dst)
+	{
+		for (VkImageMemoryBarrier2& barrier : batch.images) {
+			if (barrier.image == image && barrier.newLayout == dst.layout) {
+				barrier.dstStageMask |= dst.stages;
+				barrier.dstAccessMask |= dst.access;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * @brief Shared hazard rules for images and buffers. Returns false when no barrier is
+	 * needed, otherwise the source scope to wait on. Updates the tracked state either way.
+	 */
+	template<typename State>
+	bool resolveHazard(State& state, const ResourceAccessInfo& info, bool layoutChange,
+			VkPipelineStageFlags2& srcStages, VkAccessFlags2& srcAccess)
+	{
+		if (!info.write && !layoutChange) {
+			// Read after read, or a read at stages that already see the last write.
+			if (state.writeStages == VK_PIPELINE_STAGE_2_NONE || (state.readStages & info.stages) == info.stages) {
+				state.readStages |= info.stages;
+				return false;
+			}
+			srcStages = state.writeStages;
+			srcAccess = state.writeAccess;
+			state.readStages |= info.stages;
+			return true;
+		}
+
+		// Writes and layout transitions wait for the last write and every read since.
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+		if (info.write) {
+			state.writeStages = info.stages;
+			state.writeAccess = info.access;
+			state.readStages = VK_PIPELINE_STAGE_2_NONE;
+		} else {
+			// The transition itself is the last write; later readers chain on its destination stages.
+			state.writeStages = info.stages;
+			state.writeAccess = VK_ACCESS_2_NONE;
+			state.readStages = info.stages;
+		}
+		return srcStages != VK_PIPELINE_STAGE_2_NONE || layoutChange;
+	}
+
+} // namespace
+
+ResourceAccessInfo describeAccess(ResourceAccess access)
+{
+	switch (access) {
+	case ResourceAccess::TransferRead:
+		return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+	case ResourceAccess::TransferWrite:
+		return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+	case ResourceAccess::VertexInput:
+		return { VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+			VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+	case ResourceAccess::IndirectRead:
+		return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+	case ResourceAccess::VertexShaderRead:
+		return { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+	case ResourceAccess::FragmentShaderRead:
+		return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+	case ResourceAccess::FragmentShaderWrite:
+		return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+	case ResourceAccess::ComputeShaderRead:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+	case ResourceAccess::ComputeShaderWrite:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, true };
+	case ResourceAccess::ColorAttachmentWrite:
+		return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true };
+	case ResourceAccess::DepthAttachmentWrite:
+		return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true };
+	case ResourceAccess::DepthAttachmentRead:
+		return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false };
+	case ResourceAccess::HostRead:
+		return { VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+	case ResourceAccess::Present:
+		// Presentation is ordered by the semaphore the submission signals, not by stages.
+		return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false };
+	}
+	return { VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+}
+
+void requireImageAccess(BarrierBatch& batch, VkImage image, const VkImageSubresourceRange& range, ResourceAccess access, VulkanEngine* engine)
+{
+	ResourceAccessInfo info = describeAccess(access);
+	ImageState& state = engine->_vk.resourceStates.images[image];
+
+	VkImageLayout oldLayout = state.layout;
+	bool layoutChange = oldLayout != info.layout;
+	VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+	if (!resolveHazard(state, info, layoutChange, srcStages, srcAccess)) {
+		return;
+	}
+	state.layout = info.layout;
+
+	if (!info.write && !layoutChange && mergeRead(batch, image, info)) {
+		return;
+	}
+	batch.images.push_back(makeImageBarrier(image, range, srcStages, srcAccess, oldLayout, info));
+}
+
+void requireBufferAccess(BarrierBatch& batch, VkBuffer buffer, ResourceAccess access, VulkanEngine* engine)
+{
+	ResourceAccessInfo info = describeAccess(access);
+	BufferState& state = engine->_vk.resourceStates.buffers[buffer];
+
+	VkBufferMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+	if (!resolveHazard(state, info, false, barrier.srcStageMask, barrier.srcAccessMask)) {
+		return;
+	}
+	barrier.dstStageMask = info.stages;
+	barrier.dstAccessMask = info.access;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	batch.buffers.push_back(barrier);
+}
+
+void requireMemoryAccess(BarrierBatch& batch, ResourceAccess from, ResourceAccess to)
+{
+	ResourceAccessInfo src = describeAccess(from);
+	ResourceAccessInfo dst = describeAccess(to);
+
+	VkMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = src.stages;
+	barrier.srcAccessMask = src.write ? src.access : VK_ACCESS_2_NONE;
+	barrier.dstStageMask = dst.stages;
+	barrier.dstAccessMask = dst.access;
+	batch.memory.push_back(barrier);
+}
+
+void flushBarriers(VkCommandBuffer commandBuffer, BarrierBatch& batch, VulkanEngine* engine)
+{
+	if (batch.empty()) {
+		return;
+	}
+
+	VkDependencyInfo dependency{};
+	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency.memoryBarrierCount = static_cast<uint32_t>(batch.memory.size());
+	dependency.pMemoryBarriers = batch.memory.data();
+	dependency.bufferMemoryBarrierCount = static_cast<uint32_t>(batch.buffers.size());
+	dependency.pBufferMemoryBarriers = batch.buffers.data();
+	dependency.imageMemoryBarrierCount = static_cast<uint32_t>(batch.images.size());
+	dependency.pImageMemoryBarriers = batch.images.data();
+	vkCmdPipelineBarrier2(commandBuffer, &dependency);
+
+	ResourceStates& states = engine->_vk.resourceStates;
+	states.barrierCalls++;
+	states.barriers += batch.memory.size() + batch.buffers.size() + batch.images.size();
+
+	batch.images.clear();
+	batch.buffers.clear();
+	batch.memory.clear();
+}
+
+void setImageState(VkImage image, ResourceAccess access, VulkanEngine* engine)
+{
+	ResourceAccessInfo info = describeAccess(access);
+	ImageState& state = engine->_vk.resourceStates.images[image];
+	state.layout = info.layout;
+	state.writeStages = VK_PIPELINE_STAGE_2_NONE;
+	state.writeAccess = VK_ACCESS_2_NONE;
+	state.readStages = info.stages;
+}
+
+void discardImage(VkImage image, VkPipelineStageFlags2 waitStages, VkAccessFlags2 waitAccess, VulkanEngine* engine)
+{
+	ImageState& state = engine->_vk.resourceStates.images[image];
+	state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	state.writeStages |= state.readStages | waitStages;
+	state.writeAccess |= waitAccess;
+	state.readStages = VK_PIPELINE_STAGE_2_NONE;
+}
+
+const ImageState* findImageState(VkImage image, VulkanEngine* engine)
+{
+	auto it = engine->_vk.resourceStates.images.find(image);
+	return it != engine->_vk.resourceStates.images.end() ? &it->second : nullptr;
+}
+
+void settleImage(VkImage image, VulkanEngine* engine)
+{
+	ImageState& state = engine->_vk.resourceStates.images[image];
+	state.writeStages = VK_PIPELINE_STAGE_2_NONE;
+	state.writeAccess = VK_ACCESS_2_NONE;
+	state.readStages = VK_PIPELINE_STAGE_2_NONE;
+}
+
+void settleBuffer(VkBuffer buffer, VulkanEngine* engine)
+{
+	engine->_vk.resourceStates.buffers[buffer] = BufferState{};
+}
+
+void forgetImage(VkImage image, VulkanEngine* engine)
+{
+	engine->_vk.resourceStates.images.erase(image);
+}
+
+void forgetBuffer(VkBuffer buffer, VulkanEngine* engine)
+{
+	engine->_vk.resourceStates.buffers.erase(buffer);
+}
+
+VkImageSubresourceRange colorRange(uint32_t mipLevels, uint32_t layerCount)
+{
+	return { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layerCount };
+}
@@ -1,56 +1,58 @@
 #include "vulkan/VulkanEngine.hpp"
 #include "vulkan/VulkanBuffer.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanCommandBuffer.hpp"
+#include "vulkan/VulkanStaging.hpp"
+#include "vulkan/VulkanFrameAllocator.hpp"
+#include "vulkan/VulkanDefrag.hpp"
+#include "vulkan/VulkanCulling.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include <cstring>
 #include <chrono>
+#include <cmath>
+#include <limits>
+#include <span>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <vulkan/vulkan_core.h>
 
-void createVertexBuffer(std::vector<Vertex> vertices, VulkanEngine* engine)
+void createVertexBuffer(const std::vector<Vertex>& vertices, UploadBatch& uploads, VulkanEngine* engine)
 {
 	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	createBuffer(bufferSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer,
-		stagingBufferMemory,
-		engine);
 
-	void* data;
-	vkMapMemory(engine->_vk.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(engine->_vk.device, stagingBufferMemory);
+	// Bounding sphere around the box center; loose, but all the culling pass needs.
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(std::numeric_limits<float>::lowest());
+	for (const Vertex& vertex : vertices) {
+		minimum = glm::min(minimum, vertex.position);
+		maximum = glm::max(maximum, vertex.position);
+	}
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+	for (const Vertex& vertex : vertices) {
+		radius = std::max(radius, glm::length(vertex.position - center));
+	}
+	engine->_vk.meshBounds = glm::vec4(center, radius);
 
-	createBuffer(bufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		engine->_vk.vertexBuffer,
-		engine->_vk.vertexBufferMemory,
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	engine->_vk.vertexBuffer = createBuffer(bufferSize,
+		usage,
+		0,
 		engine);
-
-	copyBuffer(stagingBuffer, engine->_vk.vertexBuffer, bufferSize, engine);
-
-	vkDestroyBuffer(engine->_vk.device, stagingBuffer, nullptr);
-	vkFreeMemory(engine->_vk.device, stagingBufferMemory, nullptr);
+	// Bound by handle when the scene is recorded, so moving it needs the new handle and a re-record.
+	registerMovableBuffer(engine->_vk.vertexBuffer, bufferSize, usage,
+		[engine](VkBuffer buffer) {
+			engine->_vk.vertexBuffer.buffer = buffer;
+			invalidateSceneCommands(engine);
+		}, engine);
+
+	uploadBuffer(uploads, vertices.data(), bufferSize, engine->_vk.vertexBuffer.buffer, 0, engine);
 }
 
-VkCommandBuffer beginSingleTimeCommands(VulkanEngine *engine)
+VkCommandBuffer beginSingleTimeCommands(UploadQueue queue, VulkanEngine *engine)
 {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = engine->_vk.commandPool;
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer;
-
-	if (vkAllocateCommandBuffers(engine->_vk.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate command buffer!");
-	}
+	VkCommandBuffer commandBuffer = acquireOneShotCommandBuffer(queue, engine);
 
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -61,122 +63,243 @@ VkCommandBuffer beginSingleTimeCommands(VulkanEngine *engine)
 	return commandBuffer;
 }
 
-void endSingleTimeCommands(VkCommandBuffer commandBuffer, VulkanEngine *engine)
+uint64_t endSingleTimeCommands(VkCommandBuffer commandBuffer, UploadQueue queue, VulkanEngine *engine)
 {
+	// Uploads are not waited on; make their writes visible to everything submitted afterwards
+	// on this queue. Other families see them through ownership transfers instead.
+	BarrierBatch barriers;
+	VkMemoryBarrier2& barrier = barriers.memory.emplace_back();
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+	flushBarriers(commandBuffer, barriers, engine);
+
 	vkEndCommandBuffer(commandBuffer);
 
+	QueueTimeline& timeline = queue == UploadQueue::Transfer ? engine->_vk.transferTimeline : engine->_vk.graphicsTimeline;
+	uint64_t signalValue = timeline.value + 1;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &timeline.semaphore;
 
-	vkQueueSubmit(engine->_vk.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(engine->_vk.graphicsQueue);
+	VkQueue submitQueue = queue == UploadQueue::Transfer ? engine->_vk.transferQueue : engine->_vk.graphicsQueue;
+	if (vkQueueSubmit(submitQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit single time commands!");
+	}
+	timeline.value = signalValue;
 
-	vkFreeCommandBuffers(engine->_vk.device, engine->_vk.commandPool, 1, &commandBuffer);
+	// The command buffer and the staging space it reads are recycled once the timeline reaches signalValue.
+	return trackStagingSubmission(queue, signalValue, commandBuffer, engine);
 }
 
-void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VulkanEngine* engine)
-{
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands(engine);
+namespace {
+
+	AllocatedBuffer createBufferForFamilies(VkDeviceSize size, VkBufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags,
+		std::span<const uint32_t> queueFamilies, VulkanEngine* engine)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = queueFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		if (queueFamilies.size() > 1) {
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+			bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+		}
 
-	VkBufferCopy copyRegion{};
-	copyRegion.size = size;
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+		allocInfo.flags = allocationFlags;
 
-	endSingleTimeCommands(commandBuffer, engine);
-}
+		constexpr VmaAllocationCreateFlags hostAccess =
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+		if (allocationFlags & hostAccess) {
+			allocInfo.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
+			allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		}
 
-void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory, VulkanEngine* engine)
-{
-	VkBufferCreateInfo bufferInfo{};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = size;
-	bufferInfo.usage = usage;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-	if (vkCreateBuffer(engine->_vk.device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create buffer!");
+		AllocatedBuffer buffer;
+		if (vmaCreateBuffer(engine->_vk.allocator, &bufferInfo, &allocInfo, &buffer.buffer, &buffer.allocation, &buffer.allocationInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create buffer!");
+		}
+
+		return buffer;
 	}
 
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(engine->_vk.device, buffer, &memRequirements);
+} // namespace
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, engine);
+AllocatedBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags, VulkanEngine* engine)
+{
+	return createBufferForFamilies(size, usage, allocationFlags, {}, engine);
+}
 
-	if (vkAllocateMemory(engine->_vk.device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate buffer memory!");
+AllocatedBuffer createSharedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaAllocationCreateFlags allocationFlags, VulkanEngine* engine)
+{
+	if (!engine->_vk.asyncCompute) {
+		return createBuffer(size, usage, allocationFlags, engine);
 	}
-
-	vkBindBufferMemory(engine->_vk.device, buffer, bufferMemory, 0);
+	uint32_t families[] = { engine->_vk.graphicsQueueFamily, engine->_vk.computeQueueFamily };
+	return createBufferForFamilies(size, usage, allocationFlags, families, engine);
 }
 
-uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VulkanEngine* engine)
+void destroyBuffer(AllocatedBuffer& buffer, VulkanEngine* engine)
 {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(engine->_vk.physicalDevice, &memProperties);
-
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i;
-		}
+	forgetBuffer(buffer.buffer, engine);
+	if (releaseMovable(buffer.allocation, engine)) {
+		vkDestroyBuffer(engine->_vk.device, buffer.buffer, nullptr);
+	} else {
+		vmaDestroyBuffer(engine->_vk.allocator, buffer.buffer, buffer.allocation);
 	}
-
-	throw std::runtime_error("Failed to find suitable memory type!");
+	buffer = AllocatedBuffer{};
 }
 
-void createIndexBuffer(std::vector<uint32_t> indices, VulkanEngine* engine)
+void createIndexBuffer(const std::vector<uint32_t>& indices, UploadBatch& uploads, VulkanEngine* engine)
 {
 	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, engine);
-
-	void* data;
-	vkMapMemory(engine->_vk.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(engine->_vk.device, stagingBufferMemory);
 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, engine->_vk.indexBuffer, engine->_vk.indexBufferMemory, engine);
-	copyBuffer(stagingBuffer, engine->_vk.indexBuffer, bufferSize, engine);
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	engine->_vk.indexBuffer = createBuffer(bufferSize, usage, 0, engine);
+	registerMovableBuffer(engine->_vk.indexBuffer, bufferSize, usage,
+		[engine](VkBuffer buffer) {
+			engine->_vk.indexBuffer.buffer = buffer;
+			invalidateSceneCommands(engine);
+		}, engine);
+	uploadBuffer(uploads, indices.data(), bufferSize, engine->_vk.indexBuffer.buffer, 0, engine);
 
 	engine->_vk.indexCount = static_cast<uint32_t>(indices.size());
-
-	vkDestroyBuffer(engine->_vk.device, stagingBuffer, nullptr);
-	vkFreeMemory(engine->_vk.device, stagingBufferMemory, nullptr);
 }
 
-void createUniformBuffers(VulkanEngine* engine)
+void createInstanceBuffer(VulkanEngine* engine)
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-	engine->_vk.uniformBuffers.resize(engine->_vk.swapchainImages.size());
-	engine->_vk.uniformBuffersMemory.resize(engine->_vk.swapchainImages.size());
-	engine->_vk.uniformBuffersMapped.resize(engine->_vk.swapchainImages.size());
+	engine->_vk.instanceBuffer = createBuffer(sizeof(InstanceData) * MAX_SCENE_INSTANCES * MAX_FRAMES_IN_FLIGHT,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, engine);
+	engine->_vk.instanceCount = 0;
+}
+
+namespace {
 
-	for (size_t i = 0; i < engine->_vk.swapchainImages.size(); i++) {
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, engine->_vk.uniformBuffers[i], engine->_vk.uniformBuffersMemory[i], engine);
+	const auto sceneStartTime = std::chrono::high_resolution_clock::now();
 
-		vkMapMemory(engine->_vk.device, engine->_vk.uniformBuffersMemory[i], 0, bufferSize, 0, &engine->_vk.uniformBuffersMapped[i]);
+	// View and projection of the scene camera; model is left at identity.
+	UniformBufferObject sceneCamera(VulkanEngine* engine)
+	{
+		UniformBufferObject ubo{};
+		ubo.model = glm::mat4(1.0f);
+		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		ubo.proj = glm::perspective(glm::radians(45.0f), engine->_vk.swapchainExtent.width / (float)engine->_vk.swapchainExtent.height, 0.1f, 10.0f);
+		ubo.proj[1][1] *= -1;
+		return ubo;
 	}
+
+	// Calls addModel with the scene object's transform, then with those of benchmarkDraws
+	// copies on a square grid around it.
+	template<typename AddModel>
+	void forEachSceneModel(float scale, uint32_t benchmarkDraws, AddModel&& addModel)
+	{
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - sceneStartTime).count();
+
+		glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		addModel(glm::scale(rotation, glm::vec3(scale)));
+
+		uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(benchmarkDraws))));
+		float spacing = 4.0f / std::max(side, 1u);
+		for (uint32_t i = 0; i < benchmarkDraws; ++i) {
+			glm::vec3 position((i % side + 0.5f) * spacing - 2.0f, (i / side + 0.5f) * spacing - 2.0f, 0.0f);
+			addModel(glm::scale(glm::translate(glm::mat4(1.0f), position) * rotation, glm::vec3(spacing * 0.4f)));
+		}
+	}
+
+} // namespace
+
+void buildDrawList(std::pmr::vector<DrawItem>& draws, float scale, uint32_t benchmarkDraws, VulkanEngine* engine)
+{
+	UniformBufferObject ubo = sceneCamera(engine);
+
+	draws.reserve(1 + benchmarkDraws);
+	forEachSceneModel(scale, benchmarkDraws, [&](const glm::mat4& model) {
+		ubo.model = model;
+		FrameAllocation allocation = allocateFrameUniform(sizeof(ubo), engine);
+		memcpy(allocation.data, &ubo, sizeof(ubo));
+		draws.push_back({allocation.offset, engine->_vk.indexCount, 0, 0});
+	});
 }
 
-void updateUniformBuffer(uint32_t currentImage, VulkanEngine* engine, float scale)
+void buildInstancedDrawList(std::pmr::vector<DrawItem>& draws, float scale, uint32_t benchmarkDraws, VulkanEngine* engine)
 {
-	static auto startTime = std::chrono::high_resolution_clock::now();
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+	UniformBufferObject camera = sceneCamera(engine);
+	FrameAllocation allocation = allocateFrameUniform(sizeof(camera), engine);
+	memcpy(allocation.data, &camera, sizeof(camera));
+
+	// One draw per distinct mesh, each object tagged with its draw. Scenes have a handful of
+	// meshes, so a linear search finds the draw; the last one found is tried first.
+	std::pmr::memory_resource* arena = getFrameArena(engine);
+	std::pmr::vector<DrawItem> groups(arena);
+	std::pmr::vector<uint32_t> objectGroups(arena);
+	std::pmr::vector<glm::mat4> models(arena);
+	objectGroups.reserve(1 + benchmarkDraws);
+	models.reserve(1 + benchmarkDraws);
+	uint32_t lastGroup = 0;
+	forEachSceneModel(scale, benchmarkDraws, [&](const glm::mat4& model) {
+		DrawItem mesh{allocation.offset, engine->_vk.indexCount, 0, 0, 0, 0};
+		auto sameMesh = [&mesh](const DrawItem& group) {
+			return group.indexCount == mesh.indexCount && group.firstIndex == mesh.firstIndex && group.vertexOffset == mesh.vertexOffset;
+		};
+		if (lastGroup >= groups.size() || !sameMesh(groups[lastGroup])) {
+			lastGroup = static_cast<uint32_t>(std::find_if(groups.begin(), groups.end(), sameMesh) - groups.begin());
+			if (lastGroup == groups.size()) {
+				groups.push_back(mesh);
+			}
+		}
+		groups[lastGroup].instanceCount++;
+		objectGroups.push_back(lastGroup);
+		models.push_back(model);
+	});
+	if (models.size() > MAX_SCENE_INSTANCES) {
+		throw std::runtime_error("Scene exceeds the instance buffer!");
+	}
 
-	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.model = glm::scale(ubo.model, glm::vec3(scale));
+	// Counting sort into the frame's region: every draw's instances follow those of the previous draw.
+	std::pmr::vector<uint32_t> cursors(arena);
+	cursors.reserve(groups.size());
+	uint32_t firstInstance = 0;
+	for (DrawItem& group : groups) {
+		group.firstInstance = firstInstance;
+		cursors.push_back(firstInstance);
+		firstInstance += group.instanceCount;
+	}
+	InstanceData* instances = static_cast<InstanceData*>(engine->_vk.instanceBuffer.allocationInfo.pMappedData)
+		+ static_cast<size_t>(engine->_vk.currentFrame) * MAX_SCENE_INSTANCES;
+	for (size_t i = 0; i < models.size(); ++i) {
+		instances[cursors[objectGroups[i]]++].model = models[i];
+	}
 
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), engine->_vk.swapchainExtent.width / (float)engine->_vk.swapchainExtent.height, 0.1f, 10.0f);
-	ubo.proj[1][1] *= -1;
+	engine->_vk.instanceCount = firstInstance;
+	draws.insert(draws.end(), groups.begin(), groups.end());
+}
 
-	memcpy(engine->_vk.uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+void buildGpuScene(float scale, uint32_t benchmarkDraws, VulkanEngine* engine)
+{
+	UniformBufferObject camera = sceneCamera(engine);
+	FrameAllocation allocation = allocateFrameUniform(sizeof(camera), engine);
+	memcpy(allocation.data, &camera, sizeof(camera));
+
+	std::pmr::vector<GpuObject> objects(getFrameArena(engine));
+	objects.reserve(1 + benchmarkDraws);
+	forEachSceneModel(scale, benchmarkDraws, [&](const glm::mat4& model) {
+		objects.push_back({model, engine->_vk.meshBounds, engine->_vk.indexCount, 0, 0, 0});
+	});
+	submitGpuObjects(objects, camera, allocation.offset, engine);
 }
@@ -1,21 +1,88 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <stdexcept>
 #include "vulkan/VulkanEngine.hpp"
 #include "vulkan/VulkanCommandBuffer.hpp"
-#include "vulkan/VulkanDevice.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanBuffer.hpp"
+#include "vulkan/VulkanCulling.hpp"
+#include "vulkan/VulkanFrameAllocator.hpp"
 #include "vulkan/VulkanImGui.hpp"
+#include "vulkan/VulkanRenderGraph.hpp"
+#include "vulkan/VulkanRenderPass.hpp"
+#include "vulkan/VulkanVirtualTexture.hpp"
+#include "vulkan/VulkanStaging.hpp"
 
 void createCommandPool(VulkanEngine* engine)
 {
-	QueueFamilyIndices indices = findQueueFamilies(engine->_vk.physicalDevice, engine);
-
 	VkCommandPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	poolInfo.queueFamilyIndex = indices.graphicsFamily.value();
+	poolInfo.queueFamilyIndex = engine->_vk.graphicsQueueFamily;
 
 	if (vkCreateCommandPool(engine->_vk.device, &poolInfo, nullptr, &engine->_vk.commandPool) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create command pool!");
 	}
+
+	if (engine->_vk.asyncCompute) {
+		poolInfo.queueFamilyIndex = engine->_vk.computeQueueFamily;
+		if (vkCreateCommandPool(engine->_vk.device, &poolInfo, nullptr, &engine->_vk.computeCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute command pool!");
+		}
+	}
+
+	// One-shot command buffers are short lived and recycled one at a time once their submission retires.
+	uint32_t families[] = { engine->_vk.graphicsQueueFamily, engine->_vk.transferQueueFamily };
+	for (size_t i = 0; i < engine->_vk.oneShotPools.size(); ++i) {
+		VkCommandPoolCreateInfo oneShotPoolInfo{};
+		oneShotPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		oneShotPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		oneShotPoolInfo.queueFamilyIndex = families[i];
+
+		if (vkCreateCommandPool(engine->_vk.device, &oneShotPoolInfo, nullptr, &engine->_vk.oneShotPools[i].pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create one-shot command pool!");
+		}
+	}
+}
+
+void destroyCommandPools(VulkanEngine* engine)
+{
+	for (OneShotCommandPool& oneShot : engine->_vk.oneShotPools) {
+		vkDestroyCommandPool(engine->_vk.device, oneShot.pool, nullptr);
+		oneShot = OneShotCommandPool{};
+	}
+	vkDestroyCommandPool(engine->_vk.device, engine->_vk.computeCommandPool, nullptr);
+	vkDestroyCommandPool(engine->_vk.device, engine->_vk.commandPool, nullptr);
+}
+
+VkCommandBuffer acquireOneShotCommandBuffer(UploadQueue queue, VulkanEngine* engine)
+{
+	OneShotCommandPool& oneShot = engine->_vk.oneShotPools[static_cast<size_t>(queue)];
+	if (!oneShot.available.empty()) {
+		VkCommandBuffer commandBuffer = oneShot.available.back();
+		oneShot.available.pop_back();
+		return commandBuffer;
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = oneShot.pool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(engine->_vk.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate command buffer!");
+	}
+	oneShot.allocated++;
+	return commandBuffer;
+}
+
+void recycleOneShotCommandBuffer(UploadQueue queue, VkCommandBuffer commandBuffer, VulkanEngine* engine)
+{
+	// vkBeginCommandBuffer resets it implicitly, so the next user pays for the reset instead of the retire path.
+	engine->_vk.oneShotPools[static_cast<size_t>(queue)].available.push_back(commandBuffer);
 }
 
 void createCommandBuffers(VulkanEngine* engine)
@@ -33,7 +100,351 @@ void createCommandBuffers(VulkanEngine* engine)
 }
 
 
-void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, VulkanEngine* engine)
+void createRecordingPools(VulkanEngine* engine)
+{
+	uint32_t threadCount = engine->_jobs.GetThreadCount() + 1;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = engine->_vk.graphicsQueueFamily;
+
+	for (auto& pools : engine->_vk.recordingPools) {
+		pools.resize(threadCount);
+		for (ThreadCommandPool& pool : pools) {
+			if (vkCreateCommandPool(engine->_vk.device, &poolInfo, nullptr, &pool.pool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create recording command pool!");
+			}
+		}
+	}
+
+	// Cached scene commands are executed for many frames, so they are not transient.
+	poolInfo.flags = 0;
+	for (auto& pools : engine->_vk.sceneCommands.pools) {
+		pools.resize(threadCount);
+		for (ThreadCommandPool& pool : pools) {
+			if (vkCreateCommandPool(engine->_vk.device, &poolInfo, nullptr, &pool.pool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create scene command pool!");
+			}
+		}
+	}
+}
+
+void destroyRecordingPools(VulkanEngine* engine)
+{
+	auto destroyPools = [engine](std::vector<ThreadCommandPool>& pools) {
+		for (ThreadCommandPool& pool : pools) {
+			vkDestroyCommandPool(engine->_vk.device, pool.pool, nullptr);
+		}
+		pools.clear();
+	};
+	for (auto& pools : engine->_vk.recordingPools) {
+		destroyPools(pools);
+	}
+	for (auto& pools : engine->_vk.sceneCommands.pools) {
+		destroyPools(pools);
+	}
+}
+
+namespace {
+
+	void resetPools(std::vector<ThreadCommandPool>& pools, VulkanEngine* engine)
+	{
+		for (ThreadCommandPool& pool : pools) {
+			if (pool.used > 0) {
+				vkResetCommandPool(engine->_vk.device, pool.pool, 0);
+				pool.used = 0;
+			}
+		}
+	}
+
+} // namespace
+
+void resetRecordingPools(uint32_t frame, VulkanEngine* engine)
+{
+	resetPools(engine->_vk.recordingPools[frame], engine);
+}
+
+void invalidateSceneCommands(VulkanEngine* engine)
+{
+	engine->_vk.sceneCommands.version++;
+}
+
+namespace {
+
+	// Hands out a secondary command buffer from the calling thread's pool, already begun
+	// inside the frame's render pass. framebuffer may be VK_NULL_HANDLE for commands that
+	// are executed with any swapchain image.
+	VkCommandBuffer beginSecondary(std::vector<ThreadCommandPool>& pools, VkFramebuffer framebuffer,
+		VkCommandBufferUsageFlags usage, VulkanEngine* engine)
+	{
+		ThreadCommandPool& pool = pools.at(JobSystem::GetCurrentThreadIndex());
+		if (pool.used == pool.secondaries.size()) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = pool.pool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(engine->_vk.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate secondary command buffer!");
+			}
+			pool.secondaries.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = pool.secondaries[pool.used++];
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = engine->_vk.renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = usage | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording secondary command buffer!");
+		}
+		return commandBuffer;
+	}
+
+	// Secondary command buffers inherit no state from the primary.
+	void bindSceneState(VkCommandBuffer commandBuffer, VkPipeline pipeline, VulkanEngine* engine)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(engine->_vk.swapchainExtent.width);
+		viewport.height = static_cast<float>(engine->_vk.swapchainExtent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.offset = {0, 0};
+		scissor.extent = engine->_vk.swapchainExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		VkBuffer vertexBuffers[] = {engine->_vk.vertexBuffer.buffer};
+		VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+		vkCmdBindIndexBuffer(commandBuffer, engine->_vk.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	// The virtual texture this frame's scene draws sample; only the per-draw path can.
+	VirtualTexture* drawnVirtualTexture(VulkanEngine* engine)
+	{
+		bool perDraw = !engine->_vk.gpuCulling.enabled && !engine->_vk.instancedDrawing;
+		return perDraw && engine->_vk.drawVirtualTexture ? engine->_vk.sceneVirtualTexture : nullptr;
+	}
+
+	void recordDraws(VkCommandBuffer commandBuffer, std::span<const DrawItem> draws, VulkanEngine* engine)
+	{
+		VkPipelineLayout layout = engine->_vk.pipelineLayout;
+		if (const VirtualTexture* texture = drawnVirtualTexture(engine)) {
+			layout = texture->pipelineLayout;
+			bindSceneState(commandBuffer, texture->pipeline, engine);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, VIRTUAL_TEXTURE_SET, 1,
+				&texture->descriptorSets[engine->_vk.currentFrame], 0, nullptr);
+		} else {
+			bindSceneState(commandBuffer, engine->_vk.graphicsPipeline, engine);
+		}
+
+		VkDescriptorSet descriptorSet = engine->_vk.descriptorSets[engine->_vk.currentFrame];
+		for (const DrawItem& draw : draws) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1,
+				&descriptorSet, 1, &draw.uniformOffset);
+			vkCmdDrawIndexed(commandBuffer, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+		}
+	}
+
+	// The instanced scene: one draw per mesh over its range of the frame's instanceBuffer region.
+	void recordInstancedDraws(VkCommandBuffer commandBuffer, std::span<const DrawItem> draws, VulkanEngine* engine)
+	{
+		bindSceneState(commandBuffer, engine->_vk.instancedPipeline, engine);
+
+		VkBuffer instanceBuffers[] = {engine->_vk.instanceBuffer.buffer};
+		VkDeviceSize instanceOffsets[] = {sizeof(InstanceData) * MAX_SCENE_INSTANCES * engine->_vk.currentFrame};
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, instanceBuffers, instanceOffsets);
+
+		VkDescriptorSet descriptorSet = engine->_vk.descriptorSets[engine->_vk.currentFrame];
+		for (const DrawItem& draw : draws) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->_vk.pipelineLayout, 0, 1,
+				&descriptorSet, 1, &draw.uniformOffset);
+			vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+		}
+	}
+
+	// The GPU-driven scene: whatever a culling pass left in the draw commands at the given
+	// offsets, with one camera uniform.
+	void recordCulledDraws(VkCommandBuffer commandBuffer, VkDeviceSize commandsOffset, VkDeviceSize countOffset, VulkanEngine* engine)
+	{
+		const GpuCulling& culling = engine->_vk.gpuCulling;
+		bindSceneState(commandBuffer, culling.drawPipeline, engine);
+
+		VkDescriptorSet descriptorSet = engine->_vk.descriptorSets[engine->_vk.currentFrame];
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->_vk.pipelineLayout, 0, 1,
+			&descriptorSet, 1, &culling.cameraOffset);
+		vkCmdDrawIndexedIndirectCount(commandBuffer, culling.drawCommands.buffer, commandsOffset, culling.counters.buffer, countOffset,
+			culling.objectCounts[engine->_vk.currentFrame], sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	uint32_t sceneChunkCount(uint32_t drawCount, VulkanEngine* engine)
+	{
+		uint32_t threads = engine->_vk.recordingThreads ? engine->_vk.recordingThreads : engine->_jobs.GetThreadCount() + 1;
+		return std::clamp((drawCount + MIN_DRAWS_PER_SECONDARY - 1) / MIN_DRAWS_PER_SECONDARY, 1u, threads);
+	}
+
+	// Records one secondary per entry of chunks, each with a contiguous share of the draws.
+	void recordSceneChunks(std::span<const DrawItem> draws, std::span<VkCommandBuffer> chunks, std::vector<ThreadCommandPool>& pools,
+		VkFramebuffer framebuffer, VkCommandBufferUsageFlags usage, VulkanEngine* engine)
+	{
+		uint32_t drawCount = static_cast<uint32_t>(draws.size());
+		uint32_t chunkCount = static_cast<uint32_t>(chunks.size());
+		uint32_t chunkSize = (drawCount + chunkCount - 1) / chunkCount;
+
+		auto recordStart = std::chrono::steady_clock::now();
+		engine->_jobs.ParallelFor(chunkCount, [&](uint32_t chunk) {
+			uint32_t first = std::min(chunk * chunkSize, drawCount);
+			uint32_t count = std::min(chunkSize, drawCount - first);
+
+			VkCommandBuffer secondary = beginSecondary(pools, framebuffer, usage, engine);
+			recordDraws(secondary, draws.subspan(first, count), engine);
+			if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record secondary command buffer!");
+			}
+			chunks[chunk] = secondary;
+		});
+		engine->_vk.recordingMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+	}
+
+	/**
+	 * @brief The current frame slot's cached scene commands, re-recorded first if the draw
+	 * count or the cache version changed. They bind that slot's descriptor set, and the slot
+	 * was waited for, so nothing still executes them when they are reset.
+	 */
+	std::span<const VkCommandBuffer> cachedSceneCommands(std::span<const DrawItem> draws, VulkanEngine* engine)
+	{
+		SceneCommandCache& cache = engine->_vk.sceneCommands;
+		uint32_t frame = engine->_vk.currentFrame;
+		std::vector<VkCommandBuffer>& secondaries = cache.secondaries[frame];
+		if (cache.recordedVersions[frame] == cache.version && cache.recordedDraws[frame] == draws.size()) {
+			return secondaries;
+		}
+
+		resetPools(cache.pools[frame], engine);
+		secondaries.assign(sceneChunkCount(static_cast<uint32_t>(draws.size()), engine), VK_NULL_HANDLE);
+		// No framebuffer: the same commands run with whichever swapchain image was acquired.
+		recordSceneChunks(draws, secondaries, cache.pools[frame], VK_NULL_HANDLE, 0, engine);
+
+		cache.recordedVersions[frame] = cache.version;
+		cache.recordedDraws[frame] = draws.size();
+		cache.recordings++;
+		return secondaries;
+	}
+
+	// What the scene pass needs, captured by reference so the pass callback stays small.
+	struct FrameRecording {
+		uint32_t imageIndex;
+		std::span<const DrawItem> draws;
+		VulkanEngine* engine;
+	};
+
+	// With occlusion culling the scene pass is split around the depth pyramid: the early half
+	// draws what passed the first culling phase, the late half what the second phase let through.
+	enum class ScenePhase {
+		Full,
+		Early,
+		Late,
+	};
+
+	void recordScenePass(VkCommandBuffer commandBuffer, const FrameRecording& frame, ScenePhase phase)
+	{
+		VulkanEngine* engine = frame.engine;
+		uint32_t imageIndex = frame.imageIndex;
+		std::span<const DrawItem> draws = frame.draws;
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		switch (phase) {
+		case ScenePhase::Full:
+			renderPassInfo.renderPass = engine->_vk.renderPass;
+			break;
+		case ScenePhase::Early:
+			renderPassInfo.renderPass = engine->_vk.earlyRenderPass;
+			break;
+		case ScenePhase::Late:
+			renderPassInfo.renderPass = engine->_vk.lateRenderPass;
+			break;
+		}
+		renderPassInfo.framebuffer = engine->_vk.swapchainFramebuffers[imageIndex];
+		renderPassInfo.renderArea.offset = {0, 0};
+		renderPassInfo.renderArea.extent = engine->_vk.swapchainExtent;
+
+		VkClearValue clearValues[2] = {};
+		clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+		clearValues[1].depthStencil = {1.0f, 0};
+		renderPassInfo.clearValueCount = 2;
+		renderPassInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		std::vector<ThreadCommandPool>& framePools = engine->_vk.recordingPools[engine->_vk.currentFrame];
+		VkFramebuffer framebuffer = engine->_vk.swapchainFramebuffers[imageIndex];
+
+		// The scene chunks followed by the overlay, executed in this order.
+		std::pmr::vector<VkCommandBuffer> secondaries(getFrameArena(engine));
+		if (engine->_vk.gpuCulling.enabled) {
+			VkCommandBuffer culled = beginSecondary(framePools, framebuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, engine);
+			if (phase == ScenePhase::Late) {
+				recordCulledDraws(culled, LATE_DRAW_COMMANDS_OFFSET, LATE_DRAW_COUNT_OFFSET, engine);
+			} else {
+				recordCulledDraws(culled, 0, 0, engine);
+			}
+			if (vkEndCommandBuffer(culled) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record secondary command buffer!");
+			}
+			secondaries.push_back(culled);
+		} else if (engine->_vk.instancedDrawing) {
+			// A draw per mesh leaves nothing worth spreading over threads or caching.
+			VkCommandBuffer instanced = beginSecondary(framePools, framebuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, engine);
+			recordInstancedDraws(instanced, draws, engine);
+			if (vkEndCommandBuffer(instanced) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record secondary command buffer!");
+			}
+			secondaries.push_back(instanced);
+		} else if (engine->_vk.sceneCommands.enabled) {
+			std::span<const VkCommandBuffer> cached = cachedSceneCommands(draws, engine);
+			secondaries.assign(cached.begin(), cached.end());
+		} else {
+			secondaries.resize(sceneChunkCount(static_cast<uint32_t>(draws.size()), engine), VK_NULL_HANDLE);
+			recordSceneChunks(draws, secondaries, framePools, framebuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, engine);
+		}
+
+		// ImGui is not thread safe, so the overlay is recorded here on the render thread, on top of the last draws.
+		if (phase != ScenePhase::Early) {
+			VkCommandBuffer overlay = beginSecondary(framePools, framebuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, engine);
+			ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), overlay);
+			if (vkEndCommandBuffer(overlay) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record overlay command buffer!");
+			}
+			secondaries.push_back(overlay);
+		}
+
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+} // namespace
+
+void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, std::span<const DrawItem> draws, VulkanEngine* engine)
 {
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -44,48 +455,67 @@ void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, Vul
 		throw std::runtime_error("Failed to begin recording command buffer!");
 	}
 
-	VkRenderPassBeginInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = engine->_vk.renderPass;
-	renderPassInfo.framebuffer = engine->_vk.swapchainFramebuffers[imageIndex];
-	renderPassInfo.renderArea.offset = {0, 0};
-	renderPassInfo.renderArea.extent = engine->_vk.swapchainExtent;
+	engine->_vk.uploadWaitValue = recordUploadAcquires(commandBuffer, engine);
 
-	VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-	renderPassInfo.clearValueCount = 1;
-	renderPassInfo.pClearValues = &clearColor;
+	FrameRecording frame{ imageIndex, draws, engine };
+	beginRenderGraph(engine);
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	// The acquire semaphore is waited for at color attachment output, so the first transition waits there too.
+	RenderGraphResource backbuffer = importGraphImage("backbuffer", engine->_vk.swapchainImages[imageIndex], colorRange(),
+		true, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, engine);
+	RenderGraphResource depth = useGraphTransient("depth", engine->_vk.depthImage, depthRange(engine), engine);
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->_vk.graphicsPipeline);
-
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(engine->_vk.swapchainExtent.width);
-	viewport.height = static_cast<float>(engine->_vk.swapchainExtent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	bool gpuDriven = engine->_vk.gpuCulling.enabled;
+	bool occluding = gpuDriven && isCullingOcclusion(engine);
+	CullingGraphResources culling{};
+	if (gpuDriven) {
+		culling = addCullingPasses(engine);
+	}
 
-	VkRect2D scissor = {};
-	scissor.offset = {0, 0};
-	scissor.extent = engine->_vk.swapchainExtent;
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	// With occlusion culling, the depth pyramid and second culling phase go between the two halves of the scene.
+	std::array<uint32_t, 2> scenePasses{};
+	uint32_t scenePassCount = 0;
+	if (occluding) {
+		scenePasses[scenePassCount++] = addGraphPass("early scene", false,
+			[&frame](VkCommandBuffer cmd) { recordScenePass(cmd, frame, ScenePhase::Early); }, engine);
+		addOcclusionPasses(culling, depth, engine);
+		scenePasses[scenePassCount++] = addGraphPass("late scene", false,
+			[&frame](VkCommandBuffer cmd) { recordScenePass(cmd, frame, ScenePhase::Late); }, engine);
+	} else {
+		scenePasses[scenePassCount++] = addGraphPass("scene", false,
+			[&frame](VkCommandBuffer cmd) { recordScenePass(cmd, frame, ScenePhase::Full); }, engine);
+	}
+	for (uint32_t i = 0; i < scenePassCount; ++i) {
+		useGraphResource(scenePasses[i], backbuffer, ResourceAccess::ColorAttachmentWrite, engine);
+		useGraphResource(scenePasses[i], depth, ResourceAccess::DepthAttachmentWrite, engine);
+		if (gpuDriven) {
+			useGraphResource(scenePasses[i], culling.drawCommands, ResourceAccess::IndirectRead, engine);
+			useGraphResource(scenePasses[i], culling.counters, ResourceAccess::IndirectRead, engine);
+		}
+	}
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->_vk.graphicsPipeline);
-	VkBuffer vertexBuffers[] = {engine->_vk.vertexBuffer};
-	VkDeviceSize offsets[] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	// Feedback is read on the CPU once the frame slot comes around again; the pass records
+	// nothing and only exists for the barrier in front of it.
+	if (VirtualTexture* texture = drawnVirtualTexture(engine)) {
+		RenderGraphResource feedback = importGraphBuffer("virtual texture feedback",
+			texture->feedbackBuffers[engine->_vk.currentFrame].buffer, engine);
+		for (uint32_t i = 0; i < scenePassCount; ++i) {
+			useGraphResource(scenePasses[i], feedback, ResourceAccess::FragmentShaderWrite, engine);
+		}
 
-	vkCmdBindIndexBuffer(commandBuffer, engine->_vk.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		uint32_t readback = addGraphPass("feedback readback", true, [](VkCommandBuffer) {}, engine);
+		useGraphResource(readback, feedback, ResourceAccess::HostRead, engine);
+	}
 
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, engine->_vk.pipelineLayout, 0, 1, &engine->_vk.descriptorSets[imageIndex], 0, nullptr);
+	if (gpuDriven) {
+		addCullingReadback(culling, engine);
+	}
 
-	vkCmdDrawIndexed(commandBuffer, engine->_vk.indexCount, 1, 0, 0, 0);
+	uint32_t present = addGraphPass("present", true, [](VkCommandBuffer) {}, engine);
+	useGraphResource(present, backbuffer, ResourceAccess::Present, engine);
 
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+	compileRenderGraph(engine);
+	executeRenderGraph(commandBuffer, engine);
 
-	vkCmdEndRenderPass(commandBuffer);
 	vkEndCommandBuffer(commandBuffer);
 }
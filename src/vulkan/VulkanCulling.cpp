@@ -0,0 +1,751 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanCulling.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanBuffer.hpp"
+#include "vulkan/VulkanDeletionQueue.hpp"
+#include "vulkan/VulkanFrameAllocator.hpp"
+#include "vulkan/VulkanImage.hpp"
+#include "vulkan/VulkanPipeline.hpp"
+#include "vulkan/VulkanRenderGraph.hpp"
+#include "vulkan/VulkanSampler.hpp"
+#include "vulkan/VulkanTransient.hpp"
+#include "FileIO.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	// Matches local_size_x in cull.comp.
+	constexpr uint32_t CULL_GROUP_SIZE = 64;
+	// Matches local_size_x and local_size_y in depth_reduce.comp.
+	constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+	// Spheres this close to a plane may land on either side on the GPU, so validation accepts both.
+	constexpr float CULLING_TOLERANCE = 1e-4f;
+
+	// Matches the Counters block in cull.comp.
+	struct CullingCounters {
+		uint32_t drawCount;
+		uint32_t lateDrawCount;
+		uint32_t frustumCulled;
+		uint32_t earlyOccluded;
+	};
+
+	// The counters are read back first, the early and late draw commands after them.
+	constexpr VkDeviceSize READBACK_COMMANDS_OFFSET = sizeof(CullingCounters);
+	constexpr VkDeviceSize READBACK_SIZE = READBACK_COMMANDS_OFFSET + 2 * LATE_DRAW_COMMANDS_OFFSET;
+
+	// Matches the Params block in cull.comp (std140).
+	struct CullParams {
+		glm::vec4 planes[6];
+		glm::mat4 viewProjection;
+		glm::mat4 previousViewProjection;
+		glm::vec2 pyramidSize;
+		float pyramidLevels;
+		uint32_t objectCount;
+		uint32_t lateCommandOffset;
+		uint32_t occlusion;
+		uint32_t pyramidValid;
+	};
+	static_assert(offsetof(CullParams, pyramidValid) == 248, "CullParams must match the std140 layout");
+
+	// Matches the push constant block in depth_reduce.comp.
+	struct ReducePushConstants {
+		glm::uvec2 sourceSize;
+		glm::uvec2 destinationSize;
+	};
+
+	VkExtent2D pyramidLevelExtent(const DepthPyramid& pyramid, uint32_t level)
+	{
+		return { std::max(pyramid.extent.width >> level, 1u), std::max(pyramid.extent.height >> level, 1u) };
+	}
+
+	/**
+	 * @brief Creates the pyramid for the current swapchain extent. Its contents start out
+	 * undefined, so it is moved straight to the layout culling samples it in: the culling
+	 * set points at it even on frames that never read it.
+	 */
+	void createDepthPyramid(VulkanEngine* engine)
+	{
+		DepthPyramid& pyramid = engine->_vk.gpuCulling.pyramid;
+		pyramid.extent = { std::bit_floor(engine->_vk.swapchainExtent.width), std::bit_floor(engine->_vk.swapchainExtent.height) };
+		pyramid.levels = std::bit_width(std::max(pyramid.extent.width, pyramid.extent.height));
+		if (pyramid.levels > MAX_DEPTH_PYRAMID_LEVELS) {
+			throw std::runtime_error("Depth buffer too large for the depth pyramid!");
+		}
+
+		pyramid.image = createImage(pyramid.extent.width, pyramid.extent.height, pyramid.levels, 1, VK_FORMAT_R32_SFLOAT,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, engine);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramid.image.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange = colorRange(pyramid.levels);
+		if (vkCreateImageView(engine->_vk.device, &viewInfo, nullptr, &pyramid.view) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid view!");
+		}
+
+		pyramid.levelViews.resize(pyramid.levels);
+		for (uint32_t level = 0; level < pyramid.levels; ++level) {
+			viewInfo.subresourceRange.baseMipLevel = level;
+			viewInfo.subresourceRange.levelCount = 1;
+			if (vkCreateImageView(engine->_vk.device, &viewInfo, nullptr, &pyramid.levelViews[level]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create depth pyramid view!");
+			}
+		}
+
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands(UploadQueue::Graphics, engine);
+		BarrierBatch barriers;
+		requireImageAccess(barriers, pyramid.image.image, colorRange(pyramid.levels), ResourceAccess::ComputeShaderRead, engine);
+		flushBarriers(commandBuffer, barriers, engine);
+		endSingleTimeCommands(commandBuffer, UploadQueue::Graphics, engine);
+
+		pyramid.validForFrame = UINT64_MAX;
+	}
+
+	void destroyDepthPyramid(VulkanEngine* engine)
+	{
+		DepthPyramid& pyramid = engine->_vk.gpuCulling.pyramid;
+		for (VkImageView view : pyramid.levelViews) {
+			vkDestroyImageView(engine->_vk.device, view, nullptr);
+		}
+		pyramid.levelViews.clear();
+		vkDestroyImageView(engine->_vk.device, pyramid.view, nullptr);
+		destroyImage(pyramid.image, engine);
+	}
+
+	// Replaces the pyramid once the swapchain extent no longer rounds down to its size.
+	void updateDepthPyramidExtent(VulkanEngine* engine)
+	{
+		DepthPyramid& pyramid = engine->_vk.gpuCulling.pyramid;
+		VkExtent2D extent = engine->_vk.swapchainExtent;
+		if (pyramid.extent.width == std::bit_floor(extent.width) && pyramid.extent.height == std::bit_floor(extent.height)) {
+			return;
+		}
+
+		for (VkImageView& view : pyramid.levelViews) {
+			deferDestroyImageView(view, engine);
+		}
+		pyramid.levelViews.clear();
+		deferDestroyImageView(pyramid.view, engine);
+		deferDestroyImage(pyramid.image, engine);
+		createDepthPyramid(engine);
+	}
+
+	VkPipeline createComputePipeline(const char* shaderPath, VkPipelineLayout layout, VulkanEngine* engine)
+	{
+		VkShaderModule shaderModule = createShaderModule(read_file_binary(shaderPath), engine);
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = layout;
+
+		VkPipeline pipeline;
+		VkResult result = vkCreateComputePipelines(engine->_vk.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		vkDestroyShaderModule(engine->_vk.device, shaderModule, nullptr);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error(std::string("Failed to create compute pipeline for ") + shaderPath + "!");
+		}
+		return pipeline;
+	}
+
+	VkPipelineLayout createComputePipelineLayout(VkDescriptorSetLayout setLayout, uint32_t pushConstantSize, VulkanEngine* engine)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = pushConstantSize;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout layout;
+		if (vkCreatePipelineLayout(engine->_vk.device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline layout!");
+		}
+		return layout;
+	}
+
+	// Points the frame's culling set at the current pyramid, which may have been replaced since it was last used.
+	void writePyramidDescriptor(uint32_t frame, VulkanEngine* engine)
+	{
+		const GpuCulling& culling = engine->_vk.gpuCulling;
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.sampler = culling.pyramid.sampler;
+		imageInfo.imageView = culling.pyramid.view;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = culling.descriptorSets[frame];
+		write.dstBinding = 4;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(engine->_vk.device, 1, &write, 0, nullptr);
+	}
+
+	void createCullingDescriptors(VulkanEngine* engine)
+	{
+		GpuCulling& culling = engine->_vk.gpuCulling;
+
+		// Objects, draw commands, counters, parameters, depth pyramid, occluded flags; matches cull.comp.
+		std::array<VkDescriptorType, 6> types = {
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		};
+		std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+		for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+			bindings[binding].binding = binding;
+			bindings[binding].descriptorType = types[binding];
+			bindings[binding].descriptorCount = 1;
+			bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(engine->_vk.device, &layoutInfo, nullptr, &culling.setLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create culling descriptor set layout!");
+		}
+
+		std::array<VkDescriptorPoolSize, 3> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[0].descriptorCount = 4 * MAX_FRAMES_IN_FLIGHT;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+		if (vkCreateDescriptorPool(engine->_vk.device, &poolInfo, nullptr, &culling.descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create culling descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, culling.setLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = culling.descriptorPool;
+		allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		allocInfo.pSetLayouts = layouts.data();
+
+		if (vkAllocateDescriptorSets(engine->_vk.device, &allocInfo, culling.descriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate culling descriptor sets!");
+		}
+
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			std::array<VkBuffer, 6> buffers = { culling.objectBuffers[i].buffer, culling.drawCommands.buffer, culling.counters.buffer,
+				culling.paramsBuffers[i].buffer, VK_NULL_HANDLE, culling.occludedFlags.buffer };
+			std::array<VkDescriptorBufferInfo, 6> bufferInfos{};
+			std::array<VkWriteDescriptorSet, 5> writes{};
+			uint32_t writeCount = 0;
+			for (uint32_t binding = 0; binding < buffers.size(); binding++) {
+				if (buffers[binding] == VK_NULL_HANDLE) {
+					continue;
+				}
+				bufferInfos[binding].buffer = buffers[binding];
+				bufferInfos[binding].offset = 0;
+				bufferInfos[binding].range = VK_WHOLE_SIZE;
+
+				VkWriteDescriptorSet& write = writes[writeCount++];
+				write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.dstSet = culling.descriptorSets[i];
+				write.dstBinding = binding;
+				write.dstArrayElement = 0;
+				write.descriptorCount = 1;
+				write.descriptorType = types[binding];
+				write.pBufferInfo = &bufferInfos[binding];
+			}
+
+			vkUpdateDescriptorSets(engine->_vk.device, writeCount, writes.data(), 0, nullptr);
+			writePyramidDescriptor(i, engine);
+		}
+	}
+
+	// The reduction's sets are written when it is recorded, since the depth view can change with every compile.
+	void createPyramidDescriptors(VulkanEngine* engine)
+	{
+		DepthPyramid& pyramid = engine->_vk.gpuCulling.pyramid;
+
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(engine->_vk.device, &layoutInfo, nullptr, &pyramid.setLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid descriptor set layout!");
+		}
+
+		constexpr uint32_t setCount = MAX_FRAMES_IN_FLIGHT * MAX_DEPTH_PYRAMID_LEVELS;
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount = setCount;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		poolSizes[1].descriptorCount = setCount;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = setCount;
+
+		if (vkCreateDescriptorPool(engine->_vk.device, &poolInfo, nullptr, &pyramid.descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(MAX_DEPTH_PYRAMID_LEVELS, pyramid.setLayout);
+		for (auto& sets : pyramid.descriptorSets) {
+			VkDescriptorSetAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.descriptorPool = pyramid.descriptorPool;
+			allocInfo.descriptorSetCount = MAX_DEPTH_PYRAMID_LEVELS;
+			allocInfo.pSetLayouts = layouts.data();
+
+			if (vkAllocateDescriptorSets(engine->_vk.device, &allocInfo, sets.data()) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate depth pyramid descriptor sets!");
+			}
+		}
+	}
+
+	void recordCulling(VkCommandBuffer commandBuffer, uint32_t phase, VulkanEngine* engine)
+	{
+		const GpuCulling& culling = engine->_vk.gpuCulling;
+		uint32_t frame = engine->_vk.currentFrame;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.pipelineLayout, 0, 1,
+			&culling.descriptorSets[frame], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, culling.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+		vkCmdDispatch(commandBuffer, (culling.objectCounts[frame] + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	}
+
+	// Reduces depth into level 0, then every level into the next. The pyramid stays in GENERAL
+	// throughout, so between levels only the writes have to be made visible.
+	void recordDepthPyramid(VkCommandBuffer commandBuffer, VulkanEngine* engine)
+	{
+		const DepthPyramid& pyramid = engine->_vk.gpuCulling.pyramid;
+		const auto& sets = pyramid.descriptorSets[engine->_vk.currentFrame];
+
+		std::array<VkDescriptorImageInfo, 2 * MAX_DEPTH_PYRAMID_LEVELS> imageInfos{};
+		std::array<VkWriteDescriptorSet, 2 * MAX_DEPTH_PYRAMID_LEVELS> writes{};
+		for (uint32_t level = 0; level < pyramid.levels; ++level) {
+			VkDescriptorImageInfo& source = imageInfos[2 * level];
+			source.sampler = pyramid.sampler;
+			if (level == 0) {
+				source.imageView = getTransientImageView(engine->_vk.depthImage, engine);
+				source.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			} else {
+				source.imageView = pyramid.levelViews[level - 1];
+				source.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			}
+			VkDescriptorImageInfo& destination = imageInfos[2 * level + 1];
+			destination.imageView = pyramid.levelViews[level];
+			destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			for (uint32_t binding = 0; binding < 2; ++binding) {
+				VkWriteDescriptorSet& write = writes[2 * level + binding];
+				write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.dstSet = sets[level];
+				write.dstBinding = binding;
+				write.descriptorCount = 1;
+				write.descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+				write.pImageInfo = &imageInfos[2 * level + binding];
+			}
+		}
+		vkUpdateDescriptorSets(engine->_vk.device, 2 * pyramid.levels, writes.data(), 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid.pipeline);
+		VkExtent2D sourceExtent = engine->_vk.swapchainExtent;
+		for (uint32_t level = 0; level < pyramid.levels; ++level) {
+			if (level > 0) {
+				BarrierBatch barriers;
+				requireMemoryAccess(barriers, ResourceAccess::ComputeShaderWrite, ResourceAccess::ComputeShaderRead);
+				flushBarriers(commandBuffer, barriers, engine);
+			}
+
+			VkExtent2D extent = pyramidLevelExtent(pyramid, level);
+			ReducePushConstants constants{};
+			constants.sourceSize = glm::uvec2(sourceExtent.width, sourceExtent.height);
+			constants.destinationSize = glm::uvec2(extent.width, extent.height);
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid.pipelineLayout, 0, 1,
+				&sets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pyramid.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+			vkCmdDispatch(commandBuffer, (extent.width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+				(extent.height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+			sourceExtent = extent;
+		}
+	}
+
+	void recordReadback(VkCommandBuffer commandBuffer, VulkanEngine* engine)
+	{
+		const GpuCulling& culling = engine->_vk.gpuCulling;
+		uint32_t frame = engine->_vk.currentFrame;
+		VkBuffer readback = culling.readbackBuffers[frame].buffer;
+
+		VkBufferCopy countCopy{};
+		countCopy.size = sizeof(CullingCounters);
+		vkCmdCopyBuffer(commandBuffer, culling.counters.buffer, readback, 1, &countCopy);
+
+		// Only the first drawCount commands are valid, but that count is not known here.
+		if (culling.validating[frame]) {
+			std::array<VkBufferCopy, 2> commandCopies{};
+			commandCopies[0].dstOffset = READBACK_COMMANDS_OFFSET;
+			commandCopies[0].size = culling.objectCounts[frame] * sizeof(VkDrawIndexedIndirectCommand);
+			commandCopies[1] = commandCopies[0];
+			commandCopies[1].srcOffset = LATE_DRAW_COMMANDS_OFFSET;
+			commandCopies[1].dstOffset += LATE_DRAW_COMMANDS_OFFSET;
+			vkCmdCopyBuffer(commandBuffer, culling.drawCommands.buffer, readback, culling.occluding[frame] ? 2 : 1, commandCopies.data());
+		}
+	}
+
+	// Smallest distance by which the object's bounding sphere reaches inside a frustum plane;
+	// negative when cull.comp rejects it. Same math as the shader.
+	float frustumMargin(const GpuObject& object, const std::array<glm::vec4, 6>& planes)
+	{
+		glm::vec3 center = glm::vec3(object.model * glm::vec4(glm::vec3(object.sphere), 1.0f));
+		float scale = std::max({ glm::length(glm::vec3(object.model[0])), glm::length(glm::vec3(object.model[1])),
+			glm::length(glm::vec3(object.model[2])) });
+		float radius = object.sphere.w * scale;
+
+		float margin = std::numeric_limits<float>::max();
+		for (const glm::vec4& plane : planes) {
+			margin = std::min(margin, glm::dot(glm::vec3(plane), center) + plane.w + radius);
+		}
+		return margin;
+	}
+
+	/**
+	 * @brief Compares the draws the GPU produced for a frame with what the CPU reference culler
+	 * keeps. Occlusion is not modelled on the CPU, so up to `occluded` visible objects may be
+	 * missing; drawing anything outside the frustum, or anything twice, is still a mismatch.
+	 */
+	void validateFrame(uint32_t frame, std::span<const VkDrawIndexedIndirectCommand> earlyDraws,
+		std::span<const VkDrawIndexedIndirectCommand> lateDraws, uint32_t occluded, VulkanEngine* engine)
+	{
+		GpuCulling& culling = engine->_vk.gpuCulling;
+		const std::vector<GpuObject>& objects = culling.referenceObjects[frame];
+
+		std::pmr::vector<uint8_t> drawn(objects.size(), 0, getFrameArena(engine));
+		uint32_t invalid = 0;
+		for (std::span<const VkDrawIndexedIndirectCommand> draws : { earlyDraws, lateDraws }) {
+			for (const VkDrawIndexedIndirectCommand& command : draws) {
+				if (command.firstInstance >= objects.size() || drawn[command.firstInstance] || command.instanceCount != 1) {
+					invalid++;
+					continue;
+				}
+				const GpuObject& object = objects[command.firstInstance];
+				if (command.indexCount != object.indexCount || command.firstIndex != object.firstIndex
+						|| command.vertexOffset != object.vertexOffset) {
+					invalid++;
+				}
+				drawn[command.firstInstance] = 1;
+			}
+		}
+
+		uint32_t missing = 0;
+		uint32_t extra = 0;
+		for (size_t i = 0; i < objects.size(); ++i) {
+			float margin = frustumMargin(objects[i], culling.frustums[frame]);
+			if (std::abs(margin) <= CULLING_TOLERANCE) {
+				continue;
+			}
+			if (margin > 0.0f && !drawn[i]) {
+				missing++;
+			} else if (margin < 0.0f && drawn[i]) {
+				extra++;
+			}
+		}
+		missing = missing > occluded ? missing - occluded : 0;
+
+		culling.validatedFrames++;
+		if (missing + extra + invalid > 0) {
+			culling.mismatchedFrames++;
+			Logger::Warn("GPU culling differs from the CPU reference: " + std::to_string(missing) + " visible objects missing, "
+				+ std::to_string(extra) + " culled objects drawn, " + std::to_string(invalid) + " malformed draws");
+		}
+	}
+
+} // namespace
+
+void createGpuCulling(VulkanEngine* engine)
+{
+	GpuCulling& culling = engine->_vk.gpuCulling;
+	if (!culling.supported) {
+		Logger::Warn("Indirect count drawing not supported; GPU culling is unavailable");
+		return;
+	}
+	if (!culling.occlusionSupported) {
+		Logger::Warn("Depth format cannot be sampled; occlusion culling is unavailable");
+	}
+
+	// The host writes the objects and parameters every frame; the culling pass and the vertex shader read them.
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		culling.objectBuffers[i] = createSharedBuffer(MAX_GPU_OBJECTS * sizeof(GpuObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, engine);
+		culling.paramsBuffers[i] = createSharedBuffer(sizeof(CullParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, engine);
+		culling.readbackBuffers[i] = createBuffer(READBACK_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, engine);
+	}
+
+	VkBufferUsageFlags drawUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	culling.drawCommands = createSharedBuffer(2 * LATE_DRAW_COMMANDS_OFFSET, drawUsage, 0, engine);
+	culling.counters = createSharedBuffer(sizeof(CullingCounters), drawUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, engine);
+	// Occlusion culling never leaves the graphics queue.
+	culling.occludedFlags = createBuffer(MAX_GPU_OBJECTS * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0, engine);
+
+	// Nearest filtering: the reduction fetches exact texels, and culling must not blend the max depths of a level.
+	DepthPyramid& pyramid = culling.pyramid;
+	pyramid.sampler = getSampler(makeSamplerCreateInfo(VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE), engine);
+	createDepthPyramid(engine);
+
+	createCullingDescriptors(engine);
+	culling.pipelineLayout = createComputePipelineLayout(culling.setLayout, sizeof(uint32_t), engine);
+	culling.pipeline = createComputePipeline("../shaders/cull.comp.spv", culling.pipelineLayout, engine);
+	culling.drawPipeline = createScenePipeline("../shaders/indirect.vert.spv", "../shaders/shader.frag.spv", false,
+		engine->_vk.pipelineLayout, engine);
+
+	createPyramidDescriptors(engine);
+	pyramid.pipelineLayout = createComputePipelineLayout(pyramid.setLayout, sizeof(ReducePushConstants), engine);
+	pyramid.pipeline = createComputePipeline("../shaders/depth_reduce.comp.spv", pyramid.pipelineLayout, engine);
+}
+
+void destroyGpuCulling(VulkanEngine* engine)
+{
+	GpuCulling& culling = engine->_vk.gpuCulling;
+	if (!culling.supported) {
+		return;
+	}
+
+	DepthPyramid& pyramid = culling.pyramid;
+	vkDestroyPipeline(engine->_vk.device, pyramid.pipeline, nullptr);
+	vkDestroyPipelineLayout(engine->_vk.device, pyramid.pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(engine->_vk.device, pyramid.descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(engine->_vk.device, pyramid.setLayout, nullptr);
+	destroyDepthPyramid(engine);
+
+	vkDestroyPipeline(engine->_vk.device, culling.drawPipeline, nullptr);
+	vkDestroyPipeline(engine->_vk.device, culling.pipeline, nullptr);
+	vkDestroyPipelineLayout(engine->_vk.device, culling.pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(engine->_vk.device, culling.descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(engine->_vk.device, culling.setLayout, nullptr);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		destroyBuffer(culling.objectBuffers[i], engine);
+		destroyBuffer(culling.paramsBuffers[i], engine);
+		destroyBuffer(culling.readbackBuffers[i], engine);
+	}
+	destroyBuffer(culling.drawCommands, engine);
+	destroyBuffer(culling.counters, engine);
+	destroyBuffer(culling.occludedFlags, engine);
+}
+
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& viewProjection)
+{
+	// glm is column major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i]).
+	auto row = [&](int i) {
+		return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	};
+
+	std::array<glm::vec4, 6> planes = {
+		row(3) + row(0),
+		row(3) - row(0),
+		row(3) + row(1),
+		row(3) - row(1),
+		row(2),			// clip space depth starts at 0
+		row(3) - row(2),
+	};
+	for (glm::vec4& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return planes;
+}
+
+void submitGpuObjects(std::span<const GpuObject> objects, const UniformBufferObject& camera, uint32_t cameraOffset,
+	VulkanEngine* engine)
+{
+	if (objects.size() > MAX_GPU_OBJECTS) {
+		throw std::runtime_error("Too many objects for GPU culling!");
+	}
+
+	GpuCulling& culling = engine->_vk.gpuCulling;
+	DepthPyramid& pyramid = culling.pyramid;
+	uint32_t frame = engine->_vk.currentFrame;
+	memcpy(culling.objectBuffers[frame].allocationInfo.pMappedData, objects.data(), objects.size_bytes());
+
+	bool occluding = culling.occlusion && culling.occlusionSupported;
+	if (occluding) {
+		updateDepthPyramidExtent(engine);
+	}
+	writePyramidDescriptor(frame, engine);
+
+	glm::mat4 viewProjection = camera.proj * camera.view;
+	culling.cameraOffset = cameraOffset;
+	culling.objectCounts[frame] = static_cast<uint32_t>(objects.size());
+	culling.frustums[frame] = extractFrustumPlanes(viewProjection);
+	culling.validating[frame] = culling.validate;
+	culling.occluding[frame] = occluding;
+	// Kept on the CPU: reading the write-combined object buffer back would be slow.
+	if (culling.validate) {
+		culling.referenceObjects[frame].assign(objects.begin(), objects.end());
+	}
+
+	CullParams params{};
+	std::copy(culling.frustums[frame].begin(), culling.frustums[frame].end(), params.planes);
+	params.viewProjection = viewProjection;
+	params.previousViewProjection = pyramid.viewProjection;
+	params.pyramidSize = glm::vec2(pyramid.extent.width, pyramid.extent.height);
+	params.pyramidLevels = static_cast<float>(pyramid.levels);
+	params.objectCount = culling.objectCounts[frame];
+	params.lateCommandOffset = MAX_GPU_OBJECTS;
+	params.occlusion = occluding;
+	// Only a pyramid the previous frame built is worth testing against: a close enough guess
+	// at this frame's occluders, which the second phase corrects.
+	params.pyramidValid = occluding && pyramid.validForFrame == engine->_vk.frameNumber;
+	memcpy(culling.paramsBuffers[frame].allocationInfo.pMappedData, &params, sizeof(params));
+
+	if (occluding) {
+		pyramid.viewProjection = viewProjection;
+		pyramid.validForFrame = engine->_vk.frameNumber + 1;
+	}
+}
+
+bool isCullingOcclusion(VulkanEngine* engine)
+{
+	return engine->_vk.gpuCulling.occluding[engine->_vk.currentFrame];
+}
+
+CullingGraphResources addCullingPasses(VulkanEngine* engine)
+{
+	const GpuCulling& culling = engine->_vk.gpuCulling;
+	bool occluding = isCullingOcclusion(engine);
+
+	CullingGraphResources resources{};
+	resources.drawCommands = importGraphBuffer("draw commands", culling.drawCommands.buffer, engine);
+	resources.counters = importGraphBuffer("culling counters", culling.counters.buffer, engine);
+
+	uint32_t reset = addGraphPass("cull reset", false, [engine](VkCommandBuffer cmd) {
+		vkCmdFillBuffer(cmd, engine->_vk.gpuCulling.counters.buffer, 0, sizeof(CullingCounters), 0);
+	}, engine);
+	useGraphResource(reset, resources.counters, ResourceAccess::TransferWrite, engine);
+
+	// The shader adds to the counters the reset pass wrote, so it reads them as well.
+	uint32_t cull = addGraphPass("cull", false, [engine](VkCommandBuffer cmd) { recordCulling(cmd, 0, engine); }, engine);
+	useGraphResource(cull, resources.counters, ResourceAccess::ComputeShaderRead, engine);
+	useGraphResource(cull, resources.counters, ResourceAccess::ComputeShaderWrite, engine);
+	useGraphResource(cull, resources.drawCommands, ResourceAccess::ComputeShaderWrite, engine);
+
+	if (occluding) {
+		const DepthPyramid& pyramid = culling.pyramid;
+		resources.occludedFlags = importGraphBuffer("occluded flags", culling.occludedFlags.buffer, engine);
+		resources.depthPyramid = importGraphImage("depth pyramid", pyramid.image.image, colorRange(pyramid.levels), false,
+			VK_PIPELINE_STAGE_2_NONE, engine);
+		useGraphResource(cull, resources.depthPyramid, ResourceAccess::ComputeShaderRead, engine);
+		useGraphResource(cull, resources.occludedFlags, ResourceAccess::ComputeShaderWrite, engine);
+	} else if (culling.asyncCompute) {
+		// The pyramid is built from depth on the graphics queue, so occlusion culling stays there too.
+		setGraphPassQueue(reset, RenderGraphQueue::AsyncCompute, engine);
+		setGraphPassQueue(cull, RenderGraphQueue::AsyncCompute, engine);
+	}
+	return resources;
+}
+
+void addOcclusionPasses(const CullingGraphResources& resources, RenderGraphResource depth, VulkanEngine* engine)
+{
+	uint32_t reduce = addGraphPass("depth pyramid", false, [engine](VkCommandBuffer cmd) { recordDepthPyramid(cmd, engine); }, engine);
+	useGraphResource(reduce, depth, ResourceAccess::ComputeShaderRead, engine);
+	useGraphResource(reduce, resources.depthPyramid, ResourceAccess::ComputeShaderWrite, engine);
+
+	uint32_t cull = addGraphPass("occlusion cull", false, [engine](VkCommandBuffer cmd) { recordCulling(cmd, 1, engine); }, engine);
+	useGraphResource(cull, resources.depthPyramid, ResourceAccess::ComputeShaderRead, engine);
+	useGraphResource(cull, resources.occludedFlags, ResourceAccess::ComputeShaderRead, engine);
+	useGraphResource(cull, resources.counters, ResourceAccess::ComputeShaderRead, engine);
+	useGraphResource(cull, resources.counters, ResourceAccess::ComputeShaderWrite, engine);
+	useGraphResource(cull, resources.drawCommands, ResourceAccess::ComputeShaderWrite, engine);
+}
+
+void addCullingReadback(const CullingGraphResources& resources, VulkanEngine* engine)
+{
+	const GpuCulling& culling = engine->_vk.gpuCulling;
+	uint32_t frame = engine->_vk.currentFrame;
+	RenderGraphResource readback = importGraphBuffer("culling readback", culling.readbackBuffers[frame].buffer, engine);
+
+	uint32_t copy = addGraphPass("culling readback", false, [engine](VkCommandBuffer cmd) { recordReadback(cmd, engine); }, engine);
+	useGraphResource(copy, resources.counters, ResourceAccess::TransferRead, engine);
+	if (culling.validating[frame]) {
+		useGraphResource(copy, resources.drawCommands, ResourceAccess::TransferRead, engine);
+	}
+	useGraphResource(copy, readback, ResourceAccess::TransferWrite, engine);
+
+	// Read on the CPU once the frame slot comes around again; the pass only carries the host barrier.
+	uint32_t results = addGraphPass("culling results", true, [](VkCommandBuffer) {}, engine);
+	useGraphResource(results, readback, ResourceAccess::HostRead, engine);
+}
+
+void collectCullingResults(uint32_t frame, VulkanEngine* engine)
+{
+	GpuCulling& culling = engine->_vk.gpuCulling;
+	uint32_t objectCount = culling.objectCounts[frame];
+	if (objectCount == 0) {
+		return;
+	}
+	culling.objectCounts[frame] = 0;
+
+	const uint8_t* readback = static_cast<const uint8_t*>(culling.readbackBuffers[frame].allocationInfo.pMappedData);
+	CullingCounters counters{};
+	memcpy(&counters, readback, sizeof(counters));
+	uint32_t drawCount = std::min(counters.drawCount, objectCount);
+	uint32_t lateDrawCount = culling.occluding[frame] ? std::min(counters.lateDrawCount, objectCount - drawCount) : 0;
+	uint32_t earlyOccluded = std::min(counters.earlyOccluded, objectCount);
+
+	culling.visibleObjects = drawCount + lateDrawCount;
+	culling.frustumCulledObjects = std::min(counters.frustumCulled, objectCount);
+	culling.earlyOccludedObjects = earlyOccluded;
+	culling.lateOccludedObjects = earlyOccluded - std::min(lateDrawCount, earlyOccluded);
+	if (culling.validating[frame]) {
+		const auto* commands = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(readback + READBACK_COMMANDS_OFFSET);
+		validateFrame(frame, { commands, drawCount }, { commands + MAX_GPU_OBJECTS, lateDrawCount },
+			culling.lateOccludedObjects, engine);
+	}
+}
@@ -0,0 +1,313 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanDefrag.hpp"
+#include "vulkan/VulkanStaging.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanSync.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+	constexpr double MiB = 1024.0 * 1024.0;
+
+	bool shouldStartRun(VulkanEngine* engine)
+	{
+		Defragmenter& defrag = engine->_vk.defragmenter;
+		if (defrag.movable.empty() || defrag.frame % DEFRAG_CHECK_INTERVAL != 0) {
+			return false;
+		}
+		// Copies run on the graphics queue, so everything has to be owned by it already.
+		if (!engine->_vk.stagingRing.pendingAcquires.empty()) {
+			return false;
+		}
+
+		VmaTotalStatistics stats{};
+		vmaCalculateStatistics(engine->_vk.allocator, &stats);
+		const VmaStatistics& total = stats.total.statistics;
+		VkDeviceSize wasted = total.blockBytes - total.allocationBytes;
+		return wasted > DEFRAG_MIN_WASTED_BYTES && wasted > total.blockBytes * DEFRAG_MIN_WASTED_FRACTION;
+	}
+
+	void finishRun(VulkanEngine* engine)
+	{
+		Defragmenter& defrag = engine->_vk.defragmenter;
+		VmaDefragmentationStats stats{};
+		vmaEndDefragmentation(engine->_vk.allocator, defrag.context, &stats);
+		defrag.context = VK_NULL_HANDLE;
+		defrag.bytesFreed += stats.bytesFreed;
+		defrag.blocksFreed += stats.deviceMemoryBlocksFreed;
+
+		Logger::Info("Defragmentation: moved " + std::to_string(stats.bytesMoved / MiB) + " MiB in "
+			+ std::to_string(stats.allocationsMoved) + " allocations, reclaimed "
+			+ std::to_string(stats.bytesFreed / MiB) + " MiB (" + std::to_string(stats.deviceMemoryBlocksFreed)
+			+ " blocks), longest pass " + std::to_string(defrag.maxPassMilliseconds) + " ms");
+	}
+
+	// Records the copies of one pass and swaps the new handles in.
+	void beginPass(VulkanEngine* engine)
+	{
+		Defragmenter& defrag = engine->_vk.defragmenter;
+		VkDevice device = engine->_vk.device;
+
+		if (vmaBeginDefragmentationPass(engine->_vk.allocator, defrag.context, &defrag.pass) == VK_SUCCESS) {
+			finishRun(engine);
+			return;
+		}
+
+		UploadBatch batch = beginUploadBatch(UploadQueue::Graphics, engine);
+		std::vector<std::pair<VkImage, VkImage>> imageCopies;
+		std::vector<VkImageCreateInfo> imageInfos;
+
+		defrag.moves.clear();
+		for (uint32_t i = 0; i < defrag.pass.moveCount; ++i) {
+			VmaDefragmentationMove& move = defrag.pass.pMoves[i];
+			auto it = defrag.movable.find(move.srcAllocation);
+			if (it == defrag.movable.end()) {
+				// Not registered: whoever owns it cannot follow a move.
+				move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+				continue;
+			}
+
+			MovableResource& resource = it->second;
+			DefragMove pending{};
+			pending.allocation = move.srcAllocation;
+			pending.moveIndex = i;
+
+			VmaAllocationInfo info{};
+			vmaGetAllocationInfo(engine->_vk.allocator, move.srcAllocation, &info);
+
+			if (resource.bufferInfo.sType == VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO) {
+				VkBuffer newBuffer;
+				if (vkCreateBuffer(device, &resource.bufferInfo, nullptr, &newBuffer) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create buffer for defragmentation!");
+				}
+				vmaBindBufferMemory(engine->_vk.allocator, move.dstTmpAllocation, newBuffer);
+
+				pending.oldBuffer = resource.buffer;
+				resource.buffer = newBuffer;
+				VkBufferCopy copy{0, 0, resource.bufferInfo.size};
+				vkCmdCopyBuffer(batch.commandBuffer, pending.oldBuffer, newBuffer, 1, &copy);
+			} else {
+				VkImage newImage;
+				if (vkCreateImage(device, &resource.imageInfo, nullptr, &newImage) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create image for defragmentation!");
+				}
+				vmaBindImageMemory(engine->_vk.allocator, move.dstTmpAllocation, newImage);
+
+				pending.oldImage = resource.image;
+				resource.image = newImage;
+				imageCopies.emplace_back(pending.oldImage, newImage);
+				imageInfos.push_back(resource.imageInfo);
+			}
+
+			defrag.bytesMoved += info.size;
+			defrag.moves.push_back(pending);
+		}
+
+		if (!imageCopies.empty()) {
+			BarrierBatch barriers;
+			for (size_t i = 0; i < imageCopies.size(); ++i) {
+				VkImageSubresourceRange range = colorRange(imageInfos[i].mipLevels, imageInfos[i].arrayLayers);
+				requireImageAccess(barriers, imageCopies[i].first, range, ResourceAccess::TransferRead, engine);
+				requireImageAccess(barriers, imageCopies[i].second, range, ResourceAccess::TransferWrite, engine);
+			}
+			flushBarriers(batch.commandBuffer, barriers, engine);
+
+			for (size_t i = 0; i < imageCopies.size(); ++i) {
+				std::vector<VkImageCopy> regions(imageInfos[i].mipLevels);
+				for (uint32_t mip = 0; mip < imageInfos[i].mipLevels; ++mip) {
+					VkImageCopy& region = regions[mip];
+					region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, imageInfos[i].arrayLayers};
+					region.dstSubresource = region.srcSubresource;
+					region.extent = {
+						std::max(imageInfos[i].extent.width >> mip, 1u),
+						std::max(imageInfos[i].extent.height >> mip, 1u),
+						1
+					};
+				}
+				vkCmdCopyImage(batch.commandBuffer,
+					imageCopies[i].first, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					imageCopies[i].second, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<uint32_t>(regions.size()), regions.data());
+			}
+
+			// Stale references to the old image stay valid until the pass ends.
+			for (size_t i = 0; i < imageCopies.size(); ++i) {
+				VkImageSubresourceRange range = colorRange(imageInfos[i].mipLevels, imageInfos[i].arrayLayers);
+				requireImageAccess(barriers, imageCopies[i].first, range, ResourceAccess::FragmentShaderRead, engine);
+				requireImageAccess(barriers, imageCopies[i].second, range, ResourceAccess::FragmentShaderRead, engine);
+			}
+			flushBarriers(batch.commandBuffer, barriers, engine);
+		}
+
+		// Submitted ahead of this frame on the same queue, so the frame already sees the copies.
+		defrag.copySubmission = submitUploadBatch(batch, engine);
+		defrag.passActive = true;
+		defrag.passFrame = engine->_vk.frameNumber;
+		defrag.passes++;
+
+		for (const DefragMove& pending : defrag.moves) {
+			const MovableResource& resource = defrag.movable.at(pending.allocation);
+			if (pending.oldBuffer != VK_NULL_HANDLE) {
+				resource.relocateBuffer(resource.buffer);
+			} else {
+				resource.relocateImage(resource.image);
+			}
+		}
+	}
+
+	void endPass(VulkanEngine* engine)
+	{
+		Defragmenter& defrag = engine->_vk.defragmenter;
+
+		VkResult result = vmaEndDefragmentationPass(engine->_vk.allocator, defrag.context, &defrag.pass);
+		for (const DefragMove& pending : defrag.moves) {
+			forgetBuffer(pending.oldBuffer, engine);
+			vkDestroyBuffer(engine->_vk.device, pending.oldBuffer, nullptr);
+			forgetImage(pending.oldImage, engine);
+			vkDestroyImage(engine->_vk.device, pending.oldImage, nullptr);
+		}
+		for (auto& work : defrag.retired) {
+			work();
+		}
+		defrag.retired.clear();
+		defrag.moves.clear();
+		defrag.pass = {};
+		defrag.passActive = false;
+
+		if (result == VK_SUCCESS) {
+			finishRun(engine);
+		}
+	}
+
+} // namespace
+
+void registerMovableBuffer(const AllocatedBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage,
+		std::function<void(VkBuffer)> relocate, VulkanEngine* engine)
+{
+	if (!(usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) {
+		throw std::invalid_argument("Movable buffers need TRANSFER_SRC usage!");
+	}
+
+	MovableResource resource{};
+	resource.buffer = buffer.buffer;
+	resource.bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	resource.bufferInfo.size = size;
+	resource.bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	resource.bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	resource.relocateBuffer = std::move(relocate);
+
+	engine->_vk.defragmenter.movable[buffer.allocation] = std::move(resource);
+}
+
+void registerMovableImage(const AllocatedImage& image, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers,
+		VkFormat format, VkImageUsageFlags usage, std::function<void(VkImage)> relocate, VulkanEngine* engine)
+{
+	if (!(usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+		throw std::invalid_argument("Movable images need TRANSFER_SRC usage!");
+	}
+
+	MovableResource resource{};
+	resource.image = image.image;
+	resource.imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	resource.imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	resource.imageInfo.extent = {width, height, 1};
+	resource.imageInfo.mipLevels = mipLevels;
+	resource.imageInfo.arrayLayers = arrayLayers;
+	resource.imageInfo.format = format;
+	resource.imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	resource.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	resource.imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	resource.imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	resource.relocateImage = std::move(relocate);
+
+	engine->_vk.defragmenter.movable[image.allocation] = std::move(resource);
+}
+
+void deferUntilDefragPassEnds(std::function<void()> work, VulkanEngine* engine)
+{
+	Defragmenter& defrag = engine->_vk.defragmenter;
+	if (!defrag.passActive) {
+		work();
+		return;
+	}
+	defrag.retired.push_back(std::move(work));
+}
+
+bool releaseMovable(VmaAllocation allocation, VulkanEngine* engine)
+{
+	Defragmenter& defrag = engine->_vk.defragmenter;
+	if (defrag.movable.erase(allocation) == 0 || !defrag.passActive) {
+		return false;
+	}
+
+	for (const DefragMove& pending : defrag.moves) {
+		if (pending.allocation == allocation) {
+			// The pass frees both the old and the new place; the old handle goes with the pass.
+			defrag.pass.pMoves[pending.moveIndex].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+			return true;
+		}
+	}
+	return false;
+}
+
+void updateDefragmentation(VulkanEngine* engine)
+{
+	Defragmenter& defrag = engine->_vk.defragmenter;
+	defrag.frame++;
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (defrag.passActive) {
+		// Frames submitted before the swap may still reference the old handles.
+		if (getCompletedFrame(engine) < defrag.passFrame || !isUploadComplete(defrag.copySubmission, engine)) {
+			return;
+		}
+		endPass(engine);
+	} else if (defrag.context == VK_NULL_HANDLE) {
+		if (!shouldStartRun(engine)) {
+			return;
+		}
+
+		VmaDefragmentationInfo info{};
+		info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+		info.maxBytesPerPass = DEFRAG_MAX_BYTES_PER_PASS;
+		info.maxAllocationsPerPass = DEFRAG_MAX_ALLOCATIONS_PER_PASS;
+		if (vmaBeginDefragmentation(engine->_vk.allocator, &info, &defrag.context) != VK_SUCCESS) {
+			Logger::Warn("Failed to begin defragmentation");
+			return;
+		}
+		defrag.runs++;
+	}
+
+	if (defrag.context != VK_NULL_HANDLE && !defrag.passActive) {
+		beginPass(engine);
+	}
+
+	defrag.lastPassMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	defrag.maxPassMilliseconds = std::max(defrag.maxPassMilliseconds, defrag.lastPassMilliseconds);
+}
+
+void destroyDefragmenter(VulkanEngine* engine)
+{
+	Defragmenter& defrag = engine->_vk.defragmenter;
+	if (defrag.passActive) {
+		endPass(engine);
+	}
+	if (defrag.context != VK_NULL_HANDLE) {
+		finishRun(engine);
+	}
+
+	if (defrag.runs > 0) {
+		Logger::Info("Defragmentation: " + std::to_string(defrag.runs) + " runs, " + std::to_string(defrag.passes)
+			+ " passes, reclaimed " + std::to_string(defrag.bytesFreed / MiB) + " MiB in "
+			+ std::to_string(defrag.blocksFreed) + " blocks");
+	}
+	defrag = Defragmenter{};
+}
@@ -0,0 +1,82 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanDeletionQueue.hpp"
+#include "vulkan/VulkanBuffer.hpp"
+#include "vulkan/VulkanImage.hpp"
+#include "vulkan/VulkanSync.hpp"
+#include "Logger.hpp"
+
+#include <string>
+
+namespace {
+
+	void runCompleted(DeletionQueue& queue, uint64_t completedFrame)
+	{
+		while (!queue.pending.empty() && queue.pending.front().first <= completedFrame) {
+			// Pop first: the destroy may queue more work.
+			std::function<void()> destroy = std::move(queue.pending.front().second);
+			queue.pending.pop_front();
+			destroy();
+			queue.destroyed++;
+		}
+	}
+
+} // namespace
+
+void deferDestroy(std::function<void()> destroy, VulkanEngine* engine)
+{
+	// The frame being recorded may already reference the resource, so wait for it too.
+	engine->_vk.deletionQueue.pending.emplace_back(engine->_vk.frameNumber + 1, std::move(destroy));
+}
+
+void deferDestroyBuffer(AllocatedBuffer& buffer, VulkanEngine* engine)
+{
+	deferDestroy([engine, buffer]() mutable { destroyBuffer(buffer, engine); }, engine);
+	buffer = AllocatedBuffer{};
+}
+
+void deferDestroyImage(AllocatedImage& image, VulkanEngine* engine)
+{
+	deferDestroy([engine, image]() mutable { destroyImage(image, engine); }, engine);
+	image = AllocatedImage{};
+}
+
+void deferDestroyImageView(VkImageView& view, VulkanEngine* engine)
+{
+	deferDestroy([engine, view]() { vkDestroyImageView(engine->_vk.device, view, nullptr); }, engine);
+	view = VK_NULL_HANDLE;
+}
+
+void deferDestroyFramebuffer(VkFramebuffer& framebuffer, VulkanEngine* engine)
+{
+	deferDestroy([engine, framebuffer]() { vkDestroyFramebuffer(engine->_vk.device, framebuffer, nullptr); }, engine);
+	framebuffer = VK_NULL_HANDLE;
+}
+
+void deferDestroyPipeline(VkPipeline& pipeline, VulkanEngine* engine)
+{
+	deferDestroy([engine, pipeline]() { vkDestroyPipeline(engine->_vk.device, pipeline, nullptr); }, engine);
+	pipeline = VK_NULL_HANDLE;
+}
+
+void deferDestroySemaphore(VkSemaphore& semaphore, VulkanEngine* engine)
+{
+	deferDestroy([engine, semaphore]() { vkDestroySemaphore(engine->_vk.device, semaphore, nullptr); }, engine);
+	semaphore = VK_NULL_HANDLE;
+}
+
+void collectDeletionQueue(VulkanEngine* engine)
+{
+	DeletionQueue& queue = engine->_vk.deletionQueue;
+	if (!queue.pending.empty()) {
+		runCompleted(queue, getCompletedFrame(engine));
+	}
+}
+
+void flushDeletionQueue(VulkanEngine* engine)
+{
+	DeletionQueue& queue = engine->_vk.deletionQueue;
+	runCompleted(queue, UINT64_MAX);
+
+	Logger::Info("Deletion queue: " + std::to_string(queue.destroyed) + " deferred destroys over "
+		+ std::to_string(engine->_vk.frameNumber) + " frames");
+}
@@ -1,9 +1,12 @@
 #include "vulkan/VulkanDevice.hpp"
 #include "vulkan/VulkanEngine.hpp"
 #include "vulkan/VulkanSwapchain.hpp"
+#include "Logger.hpp"
+#include <cstring>
 #include <stdexcept>
 #include <vector>
 #include <set>
+#include <string>
 
 
 const std::vector<const char*> validationLayers = {
@@ -38,30 +41,74 @@ void createLogicalDevice(VulkanEngine* engine)
 	QueueFamilyIndices indices = findQueueFamilies(engine->_vk.physicalDevice, engine);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+	uint32_t transferFamily = indices.transferFamily.value_or(indices.graphicsFamily.value());
+	std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), transferFamily};
+	if (indices.computeFamily.has_value()) {
+		uniqueQueueFamilies.insert(indices.computeFamily.value());
+	}
+	// Async compute takes the second queue when it shares the transfer family.
+	uint32_t computeQueueIndex = indices.computeFamily == transferFamily ? 1 : 0;
 
-	float queuePriority = 1.0f;
+	float queuePriorities[] = { 1.0f, 1.0f };
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
 		VkDeviceQueueCreateInfo queueCreateInfo{};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamily;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		queueCreateInfo.queueCount = queueFamily == indices.computeFamily ? computeQueueIndex + 1 : 1;
+		queueCreateInfo.pQueuePriorities = queuePriorities;
 
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+	supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supportedFeatures2{};
+	supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures2.pNext = &supportedVulkan12Features;
+	vkGetPhysicalDeviceFeatures2(engine->_vk.physicalDevice, &supportedFeatures2);
+	const VkPhysicalDeviceFeatures& supportedFeatures = supportedFeatures2.features;
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	// Virtual texture feedback is written from fragment shaders.
+	engine->_vk.virtualTexturesSupported = supportedFeatures.fragmentStoresAndAtomics;
+	deviceFeatures.fragmentStoresAndAtomics = engine->_vk.virtualTexturesSupported;
+
+	// Optional: the GPU-driven path draws every culled object with one indirect count draw,
+	// and finds each object through firstInstance.
+	engine->_vk.gpuCulling.supported = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance
+		&& supportedVulkan12Features.drawIndirectCount;
+	deviceFeatures.multiDrawIndirect = engine->_vk.gpuCulling.supported;
+	deviceFeatures.drawIndirectFirstInstance = engine->_vk.gpuCulling.supported;
+
+	// Barriers are recorded with vkCmdPipelineBarrier2.
+	VkPhysicalDeviceVulkan13Features vulkan13Features{};
+	vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	vulkan13Features.synchronization2 = VK_TRUE;
+
+	// Upload completion is tracked with timeline semaphores.
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.pNext = &vulkan13Features;
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+	vulkan12Features.drawIndirectCount = engine->_vk.gpuCulling.supported;
 
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &vulkan12Features;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	// Optional: real heap budgets instead of VMA's estimates.
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	engine->_vk.memoryBudget.extensionEnabled = isDeviceExtensionSupported(engine->_vk.physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (engine->_vk.memoryBudget.extensionEnabled) {
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	if (bEnableValidationLayers) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -75,6 +122,20 @@ void createLogicalDevice(VulkanEngine* engine)
 
 	vkGetDeviceQueue(engine->_vk.device, indices.graphicsFamily.value(), 0, &engine->_vk.graphicsQueue);
 	vkGetDeviceQueue(engine->_vk.device, indices.presentFamily.value(), 0, &engine->_vk.presentQueue);
+	vkGetDeviceQueue(engine->_vk.device, transferFamily, 0, &engine->_vk.transferQueue);
+
+	engine->_vk.graphicsQueueFamily = indices.graphicsFamily.value();
+	engine->_vk.transferQueueFamily = transferFamily;
+
+	engine->_vk.asyncCompute = indices.computeFamily.has_value();
+	engine->_vk.computeQueueFamily = indices.computeFamily.value_or(indices.graphicsFamily.value());
+	if (engine->_vk.asyncCompute) {
+		vkGetDeviceQueue(engine->_vk.device, engine->_vk.computeQueueFamily, computeQueueIndex, &engine->_vk.computeQueue);
+		Logger::Info("Async compute runs on queue family " + std::to_string(engine->_vk.computeQueueFamily));
+	} else {
+		engine->_vk.computeQueue = engine->_vk.graphicsQueue;
+		Logger::Info("No separate compute queue family; async compute passes run on the graphics queue");
+	}
 }
 
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VulkanEngine* engine)
@@ -95,6 +156,34 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VulkanEngine* engi
 		if (presentSupport) {
 			indices.presentFamily = i;
 		}
+
+		// Families without graphics can copy (compute implies transfer support); transfer-only
+		// families are usually the DMA engines, so they win over async compute ones. Atlas
+		// uploads copy to arbitrary texel offsets, which needs a 1x1x1 transfer granularity.
+		VkExtent3D granularity = families[i].minImageTransferGranularity;
+		if (!(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				&& (families[i].queueFlags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT))
+				&& granularity.width == 1 && granularity.height == 1 && granularity.depth == 1) {
+			bool transferOnly = !(families[i].queueFlags & VK_QUEUE_COMPUTE_BIT);
+			if (!indices.transferFamily.has_value() || transferOnly) {
+				indices.transferFamily = i;
+			}
+		}
+	}
+
+	// Async compute must not share a queue with uploads, which are submitted independently;
+	// the transfer family only qualifies if it has a second queue.
+	for (uint32_t i = 0; i < count; ++i) {
+		if ((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) || !(families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+			continue;
+		}
+		if (i != indices.transferFamily) {
+			indices.computeFamily = i;
+			break;
+		}
+		if (families[i].queueCount > 1) {
+			indices.computeFamily = i;
+		}
 	}
 
 	return indices;
@@ -119,6 +208,22 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device)
 	return requiredExtensions.empty();
 }
 
+bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto &extension : availableExtensions) {
+		if (strcmp(extension.extensionName, extensionName) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 bool isDeviceSuitable(VkPhysicalDevice device, VulkanEngine* engine)
 {
 	QueueFamilyIndices indices = findQueueFamilies(device, engine);
@@ -130,7 +235,16 @@ bool isDeviceSuitable(VkPhysicalDevice device, VulkanEngine* engine)
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
 
-	VkPhysicalDeviceFeatures supportedFeatures;
-	vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+	VkPhysicalDeviceVulkan13Features vulkan13Features{};
+	vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.pNext = &vulkan13Features;
+	VkPhysicalDeviceFeatures2 supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &vulkan12Features;
+	vkGetPhysicalDeviceFeatures2(device, &supportedFeatures);
+	return indices.isComplete() && extensionsSupported && swapChainAdequate
+		&& supportedFeatures.features.samplerAnisotropy && vulkan12Features.timelineSemaphore
+		&& vulkan13Features.synchronization2;
 }
@@ -10,13 +10,27 @@
 #include "vulkan/VulkanImGui.hpp"
 #include "vulkan/VulkanSync.hpp"
 #include "vulkan/VulkanTexture.hpp"
+#include "vulkan/VulkanTextureAtlas.hpp"
+#include "vulkan/VulkanSampler.hpp"
+#include "vulkan/VulkanAllocator.hpp"
+#include "vulkan/VulkanStaging.hpp"
+#include "vulkan/VulkanFrameAllocator.hpp"
+#include "vulkan/VulkanDefrag.hpp"
+#include "vulkan/VulkanDeletionQueue.hpp"
+#include "vulkan/VulkanTransient.hpp"
 #include "vulkan/VulkanCommandBuffer.hpp"
+#include "vulkan/VulkanCulling.hpp"
+#include "vulkan/VulkanRenderGraph.hpp"
+#include "vulkan/VulkanVirtualTexture.hpp"
 #include "Assets/GltfLoader.hpp"
 #include "Assets/SceneTypes.hpp"
 
 #include "FileIO.hpp"
 #include "Logger.hpp"
 #include "vk_mem_alloc.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 
 void VulkanEngine::run()
@@ -80,38 +94,100 @@ void VulkanEngine::initVulkan()
 		4, 5, 1, 1, 0, 4,
 	};
 
+	using Clock = std::chrono::steady_clock;
+	auto elapsedMs = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+	const auto startupBegin = Clock::now();
+
 	std::filesystem::path texturePath = "../textures/tux.png";
 	std::filesystem::path path = "../models/Fox.glb";
-	Assets::GltfModel model;
-	if (model.Load(Gltf::GLTF_NOT_USED)) {
-		createVertexBuffer(model.GetVertices(), this);
-		createIndexBuffer(model.GetIndices(), this);
+	Assets::GltfModel model(path);
+	auto stageBegin = Clock::now();
+	bool modelLoaded = model.Load(Gltf::GLTF_NOT_USED);
+	const double parseMs = elapsedMs(stageBegin);
+	if (!modelLoaded) {
+		Logger::Warn("Failed to load model " + path.string());
 	}
 
+	stageBegin = Clock::now();
 	createInstance(this);
 	setupDebugMessenger(this);
 	createSurface(this);
 	pickPhysicalDevice(this);
 	createLogicalDevice(this);
+	createAllocator(this);
 	createSwapchain(this);
 	createImageViews(this);
 	createRenderPass(this);
+	createTextureSampler(this);
 	createDescriptorSetLayout(this);
 	createGraphicsPipeline(this);
+	declareFrameAttachments(this);
+	buildTransientImages(this);
 	createFramebuffers(this);
 	createCommandPool(this);
-	createTextureImage(texturePath, this);
+	createQueueTimelines(this);
+	createStagingRing(STAGING_RING_SIZE, this);
+	const double deviceMs = elapsedMs(stageBegin);
+
+	Assets::ImageDecodeStats decodeStats{};
+	if (modelLoaded) {
+		decodeStats = model.DecodeImages(_jobs);
+	}
+
+	// Every scene upload is recorded into one batch and submitted once to the transfer
+	// queue. Nothing waits here; the first frame waits on the transfer timeline instead.
+	stageBegin = Clock::now();
+	UploadBatch uploads = beginUploadBatch(UploadQueue::Transfer, this);
+	if (modelLoaded) {
+		createModelSamplers(model, this);
+		createModelTextures(model, uploads, this);
+	}
+	createTextureImage(texturePath, uploads, this);
 	createTextureImageView(this);
-	createTextureSampler(this);
-	createVertexBuffer(primitive.vertices, this);
-	createIndexBuffer(primitive.indices, this);
-	createUniformBuffers(this);
+	createVertexBuffer(primitive.vertices, uploads, this);
+	createIndexBuffer(primitive.indices, uploads, this);
+	requireUpload(submitUploadBatch(uploads, this), this);
+	const double uploadMs = elapsedMs(stageBegin);
+	createFrameAllocator(FRAME_ALLOCATOR_REGION_SIZE, this);
+	createFrameArenas(this);
+	createInstanceBuffer(this);
+	createGpuCulling(this);
 	createDescriptorPool(this);
 	createDescriptorSets(this);
 	createCommandBuffers(this);
+	createRecordingPools(this);
 	createSyncObjects(this);
 
+	// A procedurally generated 8k x 8k texture the scene can be drawn with instead of its own.
+	if (_vk.virtualTexturesSupported) {
+		VirtualTextureCreateInfo virtualTextureInfo{};
+		virtualTextureInfo.name = "procedural";
+		virtualTextureInfo.provider = makeProceduralPageProvider(virtualTextureInfo);
+		_vk.sceneVirtualTexture = createVirtualTexture(virtualTextureInfo, this);
+	} else {
+		Logger::Warn("Fragment shader stores not supported; virtual texturing is unavailable");
+	}
+
 	::initImgui(_window, this);
+
+	auto megabytesPerSecond = [](size_t bytes, double ms) {
+		return ms > 0.0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0;
+	};
+	Logger::Info("Startup: " + std::to_string(elapsedMs(startupBegin)) + " ms (model parse " + std::to_string(parseMs)
+		+ " ms, device " + std::to_string(deviceMs) + " ms, image decode " + std::to_string(decodeStats.wallMilliseconds)
+		+ " ms, upload recording " + std::to_string(uploadMs) + " ms)");
+	if (decodeStats.imageCount > 0) {
+		Logger::Info("Image decode: " + std::to_string(decodeStats.imageCount) + " images on "
+			+ std::to_string(_jobs.GetThreadCount() + 1) + " threads, "
+			+ std::to_string(megabytesPerSecond(decodeStats.encodedBytes, decodeStats.wallMilliseconds)) + " MB/s compressed, "
+			+ std::to_string(megabytesPerSecond(decodeStats.decodedBytes, decodeStats.wallMilliseconds)) + " MB/s decoded, per image min/avg/max "
+			+ std::to_string(decodeStats.minImageMilliseconds) + "/"
+			+ std::to_string(decodeStats.totalImageMilliseconds / decodeStats.imageCount) + "/"
+			+ std::to_string(decodeStats.maxImageMilliseconds) + " ms");
+	}
+	logAllocatorStats(this);
 }
 
 void VulkanEngine::mainLoop()
@@ -130,40 +206,47 @@ void VulkanEngine::cleanup()
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 
+	while (!_vk.virtualTextures.empty()) {
+		destroyVirtualTexture(_vk.virtualTextures.back(), this);
+	}
+	_vk.sceneVirtualTexture = nullptr;
+
 	cleanupSwapchain(this);
-	vkDestroySampler(_vk.device, _vk.textureSampler, nullptr);
-	vkDestroyImageView(_vk.device, _vk.textureImageView, nullptr);
+	releaseTransientImages(this);
 
-	vkDestroyImage(_vk.device, _vk.textureImage, nullptr);
-	vkFreeMemory(_vk.device, _vk.textureImageMemory, nullptr);
+	destroyDefragmenter(this);
+	destroyModelTextures(this);
+	releaseTexture(_vk.texture, this);
+	flushDeletionQueue(this);
+	destroyTextureCache(this);
+	destroyTextureAtlases(this);
 
-	for (size_t i = 0; i < _vk.swapchainImages.size(); i++) {
-		vkDestroyBuffer(_vk.device, _vk.uniformBuffers[i], nullptr);
-		vkFreeMemory(_vk.device, _vk.uniformBuffersMemory[i], nullptr);
-	}
+	destroyFrameAllocator(this);
+	destroyFrameArenas(this);
+	destroyGpuCulling(this);
 
 	vkDestroyDescriptorPool(_vk.device, _vk.descriptorPool, nullptr);
 	vkDestroyDescriptorPool(_vk.device, _vk.imguiDescriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(_vk.device, _vk.descriptorSetLayout, nullptr);
+	destroySamplerCache(this);
 
-	vkDestroyBuffer(_vk.device, _vk.vertexBuffer, nullptr);
-	vkFreeMemory(_vk.device, _vk.vertexBufferMemory, nullptr);
-
-	vkDestroyBuffer(_vk.device, _vk.indexBuffer, nullptr);
-	vkFreeMemory(_vk.device, _vk.indexBufferMemory, nullptr);
+	destroyBuffer(_vk.vertexBuffer, this);
+	destroyBuffer(_vk.indexBuffer, this);
+	destroyBuffer(_vk.instanceBuffer, this);
 
 	vkDestroyPipeline(_vk.device, _vk.graphicsPipeline, nullptr);
+	vkDestroyPipeline(_vk.device, _vk.instancedPipeline, nullptr);
 	vkDestroyPipelineLayout(_vk.device, _vk.pipelineLayout, nullptr);
-	vkDestroyRenderPass(_vk.device, _vk.renderPass, nullptr);
+	destroyRenderPasses(this);
 
-	for (size_t i = 0; i < _vk.imageAvailableSemaphores.size(); i++) {
-		vkDestroySemaphore(_vk.device, _vk.imageAvailableSemaphores[i], nullptr);
-		vkDestroySemaphore(_vk.device, _vk.renderFinishedSemaphores[i], nullptr);
-		vkDestroyFence(_vk.device, _vk.inFlightFences[i], nullptr);
-	}
+	cleanupSyncObjects(this);
 
-	vkDestroyCommandPool(_vk.device, _vk.commandPool, nullptr);
+	destroyStagingRing(this);
+	destroyQueueTimelines(this);
+	destroyRecordingPools(this);
+	destroyCommandPools(this);
 
+	destroyAllocator(this);
 	vkDestroyDevice(_vk.device, nullptr);
 
 	if (bEnableValidationLayers)
@@ -179,6 +262,8 @@ void VulkanEngine::cleanup()
 
 void VulkanEngine::drawFrame()
 {
+	uint64_t heapAllocationsAtStart = GetThreadHeapAllocationCount();
+
 	ImGui_ImplVulkan_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
@@ -188,59 +273,154 @@ void VulkanEngine::drawFrame()
 	static float cubeScale = 1.0f;
 	ImGui::SliderFloat("Cube Scale", &cubeScale, 0.1f, 3.0f);
 
+	static int benchmarkDraws = 0;
+	static int recordingThreads = 0;
+	ImGui::SliderInt("Benchmark draws", &benchmarkDraws, 0, 100000);
+	// Without GPU culling or instancing every draw needs its own uniforms in the frame allocator.
+	uint32_t sceneBenchmarkDraws = _vk.gpuCulling.enabled || _vk.instancedDrawing
+		? static_cast<uint32_t>(benchmarkDraws) : std::min(static_cast<uint32_t>(benchmarkDraws), MAX_DRAW_LIST_BENCHMARK_DRAWS);
+	ImGui::SliderInt("Recording threads (0 = all)", &recordingThreads, 0, static_cast<int>(_jobs.GetThreadCount() + 1));
+	_vk.recordingThreads = static_cast<uint32_t>(recordingThreads);
+	ImGui::Text("Draw recording: %.3f ms for %u draws", _vk.recordingMilliseconds, sceneBenchmarkDraws + 1);
+	ImGui::Checkbox("Cache scene commands", &_vk.sceneCommands.enabled);
+	ImGui::SameLine();
+	ImGui::Checkbox("Instanced drawing", &_vk.instancedDrawing);
+	if (_vk.sceneVirtualTexture) {
+		ImGui::SameLine();
+		// Switches the pipeline the cached scene commands were recorded with.
+		if (ImGui::Checkbox("Virtual texture", &_vk.drawVirtualTexture)) {
+			invalidateSceneCommands(this);
+		}
+	}
+	if (ImGui::Button("Upload benchmark")) {
+		runUploadBenchmark(UPLOAD_BENCHMARK_BUFFERS, this);
+	}
+	ImGui::SameLine();
+	ImGui::Text("Staging ring: %llu submissions, %llu stalls",
+		static_cast<unsigned long long>(_vk.stagingRing.submissions), static_cast<unsigned long long>(_vk.stagingRing.stalls));
+	ImGui::Text("Frame CPU time: %.3f ms, scene recorded %llu times",
+		_vk.frameCpuMilliseconds, static_cast<unsigned long long>(_vk.sceneCommands.recordings));
+
+	GpuCulling& gpuCulling = _vk.gpuCulling;
+	if (gpuCulling.supported) {
+		ImGui::Checkbox("GPU culling", &gpuCulling.enabled);
+		ImGui::SameLine();
+		ImGui::Checkbox("Validate", &gpuCulling.validate);
+		if (gpuCulling.occlusionSupported) {
+			ImGui::SameLine();
+			ImGui::Checkbox("Occlusion culling", &gpuCulling.occlusion);
+		}
+		if (_vk.asyncCompute) {
+			ImGui::SameLine();
+			ImGui::Checkbox("On async compute", &gpuCulling.asyncCompute);
+		}
+		ImGui::Text("GPU culling: %u visible, %u frustum culled, %llu frames validated, %llu mismatched",
+			gpuCulling.visibleObjects, gpuCulling.frustumCulledObjects, static_cast<unsigned long long>(gpuCulling.validatedFrames),
+			static_cast<unsigned long long>(gpuCulling.mismatchedFrames));
+		if (gpuCulling.occlusion) {
+			ImGui::Text("Occlusion culled: %u in phase 1, %u in phase 2 (%u drawn late)", gpuCulling.earlyOccludedObjects,
+				gpuCulling.lateOccludedObjects, gpuCulling.earlyOccludedObjects - gpuCulling.lateOccludedObjects);
+		}
+	} else {
+		ImGui::Text("GPU culling: not supported");
+	}
+
+	const FrameAllocator& frameAllocator = _vk.frameAllocator;
+	ImGui::Text("Frame data: %.1f KiB (peak %.1f KiB of %.0f KiB)",
+		frameAllocator.lastFrameUsage / 1024.0, frameAllocator.peakUsage / 1024.0, frameAllocator.regionSize / 1024.0);
+	ImGui::Text("Frame scratch: %.1f KiB, %llu heap allocations last frame",
+		_vk.frameArenas[_vk.currentFrame][0]->GetPeakBytesUsed() / 1024.0, static_cast<unsigned long long>(_vk.frameHeapAllocations));
+
+	const TransientImages& transients = _vk.transientImages;
+	ImGui::Text("Transient attachments: %.1f MiB (%.1f MiB without aliasing, %u lazily allocated)",
+		transients.aliasedBytes / (1024.0 * 1024.0), transients.unaliasedBytes / (1024.0 * 1024.0), transients.lazyImages);
+
+	const RenderGraph& renderGraph = _vk.renderGraph;
+	ImGui::Text("Render graph: %zu passes (%u culled) in %zu submissions, compiled %llu times",
+		renderGraph.order.size(), renderGraph.culledPasses, renderGraph.batches.size(),
+		static_cast<unsigned long long>(renderGraph.compilations));
+	if (_vk.asyncCompute) {
+		ImGui::Text("Async compute: queue family %u", _vk.computeQueueFamily);
+	} else {
+		ImGui::Text("Async compute: sharing the graphics queue");
+	}
+
+	const ResourceStates& resourceStates = _vk.resourceStates;
+	ImGui::Text("Barriers: %llu in %llu calls, %zu images tracked",
+		static_cast<unsigned long long>(resourceStates.barriers), static_cast<unsigned long long>(resourceStates.barrierCalls),
+		resourceStates.images.size());
+
+	const Defragmenter& defragmenter = _vk.defragmenter;
+	ImGui::Text("Defragmentation: %.1f MiB moved, %.1f MiB reclaimed, last step %.2f ms",
+		defragmenter.bytesMoved / (1024.0 * 1024.0), defragmenter.bytesFreed / (1024.0 * 1024.0), defragmenter.lastPassMilliseconds);
+
+	const MemoryBudget& memoryBudget = _vk.memoryBudget;
+	ImGui::Text("Memory budget%s", memoryBudget.extensionEnabled ? "" : " (estimated)");
+	for (size_t i = 0; i < memoryBudget.heaps.size(); ++i) {
+		const VmaBudget& heap = memoryBudget.heaps[i];
+		const double usedMiB = heap.usage / (1024.0 * 1024.0);
+		const double budgetMiB = heap.budget / (1024.0 * 1024.0);
+		const char* kind = (memoryBudget.heapFlags[i] & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device" : "host";
+		char label[64];
+		snprintf(label, sizeof(label), "%.0f / %.0f MiB", usedMiB, budgetMiB);
+		ImGui::Text("Heap %zu (%s)", i, kind);
+		ImGui::ProgressBar(budgetMiB > 0.0 ? static_cast<float>(usedMiB / budgetMiB) : 0.0f, ImVec2(-1.0f, 0.0f), label);
+	}
+
 	ImGui::End();
 
 	ImGui::Render();
 
-	vkWaitForFences(_vk.device, 1, &_vk.inFlightFences[_vk.currentFrame], VK_TRUE, UINT64_MAX);
+	waitForFrameSlot(this);
+	collectDeletionQueue(this);
+	resetFrameAllocator(_vk.currentFrame, this);
+	resetFrameArenas(_vk.currentFrame, this);
+	resetRecordingPools(_vk.currentFrame, this);
+	updateMemoryBudget(this);
+	retireStaging(this);
+	updateDefragmentation(this);
+	if (_vk.descriptorSetsDirty & (1u << _vk.currentFrame)) {
+		updateDescriptorSet(_vk.currentFrame, this);
+	}
+	collectCullingResults(_vk.currentFrame, this);
+
+	for (VirtualTexture* texture : _vk.virtualTextures) {
+		collectVirtualTextureFeedback(texture, _vk.currentFrame, this);
+		updateVirtualTexture(texture, this);
+	}
 
 	uint32_t imageIndex;
 	VkResult result = vkAcquireNextImageKHR(
 		_vk.device, _vk.swapchain, UINT64_MAX,
 		_vk.imageAvailableSemaphores[_vk.currentFrame], VK_NULL_HANDLE, &imageIndex);
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-		vkDeviceWaitIdle(_vk.device);
+	// A suboptimal image can still be presented; the swapchain is replaced after present.
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreateSwapchain(this);
 		return;
 	}
 
-	if (_vk.imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-		vkWaitForFences(_vk.device, 1, &_vk.imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-	}
-	_vk.imagesInFlight[imageIndex] = _vk.inFlightFences[_vk.currentFrame];
-
-	vkResetFences(_vk.device, 1, &_vk.inFlightFences[_vk.currentFrame]);
+	auto cpuStart = std::chrono::steady_clock::now();
 	vkResetCommandBuffer(_vk.commandBuffers[_vk.currentFrame], 0);
 
-	recordCommandBuffer(_vk.commandBuffers[_vk.currentFrame], imageIndex, this);
-
-	updateUniformBuffer(imageIndex, this, cubeScale);
-
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-	VkSemaphore waitSemaphores[] = { _vk.imageAvailableSemaphores[_vk.currentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
-
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &_vk.commandBuffers[_vk.currentFrame];
-
-	VkSemaphore signalSemaphores[] = { _vk.renderFinishedSemaphores[imageIndex] };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
-
-	if (vkQueueSubmit(_vk.graphicsQueue, 1, &submitInfo, _vk.inFlightFences[_vk.currentFrame]) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit draw command buffer!");
+	std::pmr::vector<DrawItem> draws(getFrameArena(this));
+	if (_vk.gpuCulling.enabled) {
+		buildGpuScene(cubeScale, sceneBenchmarkDraws, this);
+	} else if (_vk.instancedDrawing) {
+		buildInstancedDrawList(draws, cubeScale, sceneBenchmarkDraws, this);
+	} else {
+		buildDrawList(draws, cubeScale, sceneBenchmarkDraws, this);
 	}
+	recordCommandBuffer(_vk.commandBuffers[_vk.currentFrame], imageIndex, draws, this);
+
+	// The present semaphore is signalled with the graphics timeline value that marks the frame as finished.
+	submitRenderGraph(_vk.imageAvailableSemaphores[_vk.currentFrame], _vk.renderFinishedSemaphores[imageIndex], this);
+	_vk.frameCpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+	presentInfo.pWaitSemaphores = &_vk.renderFinishedSemaphores[imageIndex];
 
 	VkSwapchainKHR swapChains[] = { _vk.swapchain };
 	presentInfo.swapchainCount = 1;
@@ -251,9 +431,9 @@ void VulkanEngine::drawFrame()
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || _vk.framebufferResized) {
 		_vk.framebufferResized = false;
-		vkDeviceWaitIdle(_vk.device);
 		recreateSwapchain(this);
 	}
 
+	_vk.frameHeapAllocations = GetThreadHeapAllocationCount() - heapAllocationsAtStart;
 	_vk.currentFrame = (_vk.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
@@ -0,0 +1,120 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanFrameAllocator.hpp"
+#include "vulkan/VulkanBuffer.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+} // namespace
+
+void createFrameAllocator(VkDeviceSize regionSize, VulkanEngine* engine)
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(engine->_vk.physicalDevice, &properties);
+
+	FrameAllocator& allocator = engine->_vk.frameAllocator;
+	allocator.uniformAlignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+	allocator.storageAlignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 16);
+	allocator.regionSize = alignUp(regionSize, std::max(allocator.uniformAlignment, allocator.storageAlignment));
+
+	// Dynamic offsets are 32 bit.
+	if (allocator.regionSize * MAX_FRAMES_IN_FLIGHT > UINT32_MAX) {
+		throw std::runtime_error("Frame allocator regions do not fit 32-bit dynamic offsets!");
+	}
+
+	allocator.buffer = createBuffer(allocator.regionSize * MAX_FRAMES_IN_FLIGHT,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, engine);
+	allocator.mapped = static_cast<uint8_t*>(allocator.buffer.allocationInfo.pMappedData);
+}
+
+void destroyFrameAllocator(VulkanEngine* engine)
+{
+	FrameAllocator& allocator = engine->_vk.frameAllocator;
+	Logger::Info("Frame allocator: peak " + std::to_string(allocator.peakUsage / 1024) + " KiB of "
+		+ std::to_string(allocator.regionSize / 1024) + " KiB per frame");
+
+	destroyBuffer(allocator.buffer, engine);
+	allocator = FrameAllocator{};
+}
+
+void resetFrameAllocator(uint32_t frame, VulkanEngine* engine)
+{
+	FrameAllocator& allocator = engine->_vk.frameAllocator;
+	allocator.lastFrameUsage = allocator.head;
+	allocator.frame = frame;
+	allocator.head = 0;
+}
+
+FrameAllocation allocateFrameData(VkDeviceSize size, VkDeviceSize alignment, VulkanEngine* engine)
+{
+	FrameAllocator& allocator = engine->_vk.frameAllocator;
+	VkDeviceSize start = alignUp(allocator.head, alignment);
+	if (start + size > allocator.regionSize) {
+		throw std::runtime_error("Frame allocator exhausted: " + std::to_string(start + size) + " of "
+			+ std::to_string(allocator.regionSize) + " bytes requested this frame!");
+	}
+
+	allocator.head = start + size;
+	allocator.peakUsage = std::max(allocator.peakUsage, allocator.head);
+
+	VkDeviceSize offset = allocator.frame * allocator.regionSize + start;
+	return {allocator.buffer.buffer, static_cast<uint32_t>(offset), allocator.mapped + offset};
+}
+
+FrameAllocation allocateFrameUniform(VkDeviceSize size, VulkanEngine* engine)
+{
+	return allocateFrameData(size, engine->_vk.frameAllocator.uniformAlignment, engine);
+}
+
+FrameAllocation allocateFrameStorage(VkDeviceSize size, VulkanEngine* engine)
+{
+	return allocateFrameData(size, engine->_vk.frameAllocator.storageAlignment, engine);
+}
+
+void createFrameArenas(VulkanEngine* engine)
+{
+	uint32_t threadCount = engine->_jobs.GetThreadCount() + 1;
+	for (auto& arenas : engine->_vk.frameArenas) {
+		arenas.clear();
+		for (uint32_t i = 0; i < threadCount; ++i) {
+			arenas.push_back(std::make_unique<FrameArena>());
+		}
+	}
+}
+
+void destroyFrameArenas(VulkanEngine* engine)
+{
+	size_t peak = 0;
+	uint64_t blocks = 0;
+	for (auto& arenas : engine->_vk.frameArenas) {
+		for (const auto& arena : arenas) {
+			peak = std::max(peak, arena->GetPeakBytesUsed());
+			blocks += arena->GetBlockAllocations();
+		}
+		arenas.clear();
+	}
+	Logger::Info("Frame arenas: peak " + std::to_string(peak / 1024) + " KiB per thread, "
+		+ std::to_string(blocks) + " block allocations");
+}
+
+void resetFrameArenas(uint32_t frame, VulkanEngine* engine)
+{
+	for (const auto& arena : engine->_vk.frameArenas[frame]) {
+		arena->Reset();
+	}
+}
+
+FrameArena* getFrameArena(VulkanEngine* engine)
+{
+	return engine->_vk.frameArenas[engine->_vk.currentFrame].at(JobSystem::GetCurrentThreadIndex()).get();
+}
@@ -1,18 +1,17 @@
 #include "vulkan/VulkanEngine.hpp"
 #include "vulkan/VulkanBuffer.hpp"
 #include "vulkan/VulkanImage.hpp"
+#include "vulkan/VulkanBarriers.hpp"
 #include "vulkan/VulkanTexture.hpp"
+#include "vulkan/VulkanDefrag.hpp"
 #include <cstdint>
 #include <stdexcept>
 #include <vulkan/vulkan_core.h>
 
-void createImage(uint32_t width, uint32_t height,
+AllocatedImage createImage(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers,
 		VkFormat format,
 		VkImageTiling tiling,
 		VkImageUsageFlags usage,
-		VkMemoryPropertyFlags properties,
-		VkImage &image,
-		VkDeviceMemory &imageMemory,
 		VulkanEngine *engine
 	)
 {
@@ -23,8 +22,8 @@ void createImage(uint32_t width, uint32_t height,
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = arrayLayers;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -32,23 +31,31 @@ void createImage(uint32_t width, uint32_t height,
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkCreateImage(engine->_vk.device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create image!");
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+	// Render targets are large and get recreated with the swapchain; VMA also picks a
+	// dedicated allocation on its own whenever the driver prefers one.
+	if (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+		allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
 	}
 
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(engine->_vk.device, image, &memRequirements);
+	AllocatedImage image;
+	if (vmaCreateImage(engine->_vk.allocator, &imageInfo, &allocInfo, &image.image, &image.allocation, &image.allocationInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create image!");
+	}
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, engine);
+	return image;
+}
 
-	if (vkAllocateMemory(engine->_vk.device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate image memory!");
+void destroyImage(AllocatedImage& image, VulkanEngine *engine)
+{
+	forgetImage(image.image, engine);
+	if (releaseMovable(image.allocation, engine)) {
+		vkDestroyImage(engine->_vk.device, image.image, nullptr);
+	} else {
+		vmaDestroyImage(engine->_vk.allocator, image.image, image.allocation);
 	}
-
-	vkBindImageMemory(engine->_vk.device, image, imageMemory, 0);
+	image = AllocatedImage{};
 }
 
 void createImageViews(VulkanEngine* engine)
@@ -59,86 +66,3 @@ void createImageViews(VulkanEngine* engine)
 		engine->_vk.swapchainImageViews[i] = createImageView(engine->_vk.swapchainImages[i], engine->_vk.swapchainImageFormat, engine);
 	}
 }
-
-void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VulkanEngine *engine)
-{
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands(engine);
-
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destinationStage;
-
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else {
-		throw std::invalid_argument("Unsupported layout transition!");
-	}
-
-	vkCmdPipelineBarrier(
-		commandBuffer,
-		sourceStage, destinationStage,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier
-	);
-
-	endSingleTimeCommands(commandBuffer, engine);
-}
-
-void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VulkanEngine *engine)
-{
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands(engine);
-
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-
-	region.imageOffset = {0, 0, 0};
-	region.imageExtent = {
-		width,
-		height,
-		1
-	};
-
-	vkCmdCopyBufferToImage(
-		commandBuffer,
-		buffer,
-		image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		1,
-		&region
-	);
-
-	endSingleTimeCommands(commandBuffer, engine);
-}
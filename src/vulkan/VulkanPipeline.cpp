@@ -2,10 +2,34 @@
 #include "vulkan/VulkanPipeline.hpp"
 #include "FileIO.hpp"
 
+#include <algorithm>
+#include <array>
+#include <tuple>
+
 void createGraphicsPipeline(VulkanEngine* engine)
 {
-	auto vertShaderCode = read_file_binary("../shaders/shader.vert.spv");
-	auto fragShaderCode = read_file_binary("../shaders/shader.frag.spv");
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &engine->_vk.descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+	if (vkCreatePipelineLayout(engine->_vk.device, &pipelineLayoutInfo, nullptr, &engine->_vk.pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout!");
+	}
+
+	engine->_vk.graphicsPipeline = createScenePipeline("../shaders/shader.vert.spv", "../shaders/shader.frag.spv", false,
+		engine->_vk.pipelineLayout, engine);
+	engine->_vk.instancedPipeline = createScenePipeline("../shaders/instanced.vert.spv", "../shaders/shader.frag.spv", true,
+		engine->_vk.pipelineLayout, engine);
+}
+
+VkPipeline createScenePipeline(const char* vertexShaderPath, const char* fragmentShaderPath, bool instanced,
+	VkPipelineLayout layout, VulkanEngine* engine)
+{
+	auto vertShaderCode = read_file_binary(vertexShaderPath);
+	auto fragShaderCode = read_file_binary(fragmentShaderPath);
 
 	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, engine);
 	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, engine);
@@ -37,12 +61,21 @@ void createGraphicsPipeline(VulkanEngine* engine)
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	// Per-vertex data at binding 0, then for instanced pipelines a model matrix per instance at binding 1.
+	std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {
+		Vertex::getBindingDescription(),
+		InstanceData::getInstanceBindingDescription(),
+	};
+	auto vertexAttributes = Vertex::getAttributeDescriptions();
+	auto instanceAttributes = InstanceData::getInstanceAttributeDescriptions();
+	std::array<VkVertexInputAttributeDescription,
+		std::tuple_size_v<decltype(vertexAttributes)> + std::tuple_size_v<decltype(instanceAttributes)>> attributeDescriptions{};
+	std::copy(vertexAttributes.begin(), vertexAttributes.end(), attributeDescriptions.begin());
+	std::copy(instanceAttributes.begin(), instanceAttributes.end(), attributeDescriptions.begin() + vertexAttributes.size());
+
+	vertexInputInfo.vertexBindingDescriptionCount = instanced ? 2 : 1;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instanced ? attributeDescriptions.size() : vertexAttributes.size());
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
@@ -116,17 +149,7 @@ void createGraphicsPipeline(VulkanEngine* engine)
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencil.depthTestEnable = VK_TRUE;
 	depthStencil.depthWriteEnable = VK_TRUE;
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &engine->_vk.descriptorSetLayout;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-	if (vkCreatePipelineLayout(engine->_vk.device, &pipelineLayoutInfo, nullptr, &engine->_vk.pipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create pipeline layout!");
-	}
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
 
 	VkGraphicsPipelineCreateInfo pipelineInfo = {};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -137,22 +160,25 @@ void createGraphicsPipeline(VulkanEngine* engine)
 	pipelineInfo.pViewportState = &viewportState;
 	pipelineInfo.pRasterizationState = &rasterizer;
 	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
 	pipelineInfo.pDynamicState = &dynamicStateCreateInfo;
 
-	pipelineInfo.layout = engine->_vk.pipelineLayout;
+	pipelineInfo.layout = layout;
 	pipelineInfo.renderPass = engine->_vk.renderPass;
 	pipelineInfo.subpass = 0;
 
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(engine->_vk.device, nullptr, 1, &pipelineInfo, nullptr, &engine->_vk.graphicsPipeline) != VK_SUCCESS) {
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(engine->_vk.device, nullptr, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create graphics pipeline!");
 	}
 
 	vkDestroyShaderModule(engine->_vk.device, vertShaderModule, nullptr);
 	vkDestroyShaderModule(engine->_vk.device, fragShaderModule, nullptr);
+	return pipeline;
 }
 
 
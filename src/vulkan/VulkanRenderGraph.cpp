@@ -0,0 +1,477 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanRenderGraph.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanFrameAllocator.hpp"
+#include "vulkan/VulkanRenderPass.hpp"
+#include "vulkan/VulkanStaging.hpp"
+#include "vulkan/VulkanSync.hpp"
+#include "vulkan/VulkanTransient.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+	uint64_t hashCombine(uint64_t hash, uint64_t value)
+	{
+		return hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
+	}
+
+	// Bound handles change every frame (swapchain image, frame slot); only the shape of the graph counts.
+	uint64_t hashTopology(const RenderGraph& graph)
+	{
+		std::hash<std::string_view> hashName;
+		uint64_t hash = hashCombine(graph.resourceCount, graph.passCount);
+		for (uint32_t i = 0; i < graph.resourceCount; ++i) {
+			const RenderGraphResourceInfo& resource = graph.resources[i];
+			hash = hashCombine(hash, hashName(resource.name));
+			hash = hashCombine(hash, static_cast<uint64_t>(resource.transient) << 2 | resource.isBuffer << 1 | resource.discard);
+		}
+		for (uint32_t i = 0; i < graph.passCount; ++i) {
+			const RenderGraphPass& pass = graph.passes[i];
+			hash = hashCombine(hash, hashName(pass.name));
+			hash = hashCombine(hash, static_cast<uint64_t>(pass.queue) << 1 | pass.sideEffects);
+			for (const RenderGraphUse& use : pass.uses) {
+				hash = hashCombine(hash, static_cast<uint64_t>(use.resource) << 32 | static_cast<uint32_t>(use.access));
+			}
+		}
+		return hash;
+	}
+
+	RenderGraphResource addResource(const char* name, VulkanEngine* engine)
+	{
+		RenderGraph& graph = engine->_vk.renderGraph;
+		if (graph.resourceCount == graph.resources.size()) {
+			graph.resources.emplace_back();
+		}
+
+		// Reset field by field so the name keeps its storage.
+		RenderGraphResourceInfo& resource = graph.resources[graph.resourceCount];
+		resource.name = name;
+		resource.isBuffer = false;
+		resource.transient = UINT32_MAX;
+		resource.image = VK_NULL_HANDLE;
+		resource.buffer = VK_NULL_HANDLE;
+		resource.range = {};
+		resource.discard = false;
+		resource.waitStages = VK_PIPELINE_STAGE_2_NONE;
+		resource.used = false;
+		resource.lastQueue = RenderGraphQueue::Graphics;
+		return graph.resourceCount++;
+	}
+
+	// Walks back from the passes with side effects. A pass survives if a surviving later pass
+	// reads something it writes; writes are assumed to overwrite, so a pass that loads earlier
+	// contents has to declare a read as well.
+	void cullPasses(RenderGraph& graph)
+	{
+		std::vector<bool> needed(graph.resourceCount, false);
+		std::vector<bool> alive(graph.passCount, false);
+		for (uint32_t i = graph.passCount; i-- > 0;) {
+			const RenderGraphPass& pass = graph.passes[i];
+			bool keep = pass.sideEffects;
+			for (const RenderGraphUse& use : pass.uses) {
+				keep = keep || (describeAccess(use.access).write && needed[use.resource]);
+			}
+			if (!keep) {
+				continue;
+			}
+			alive[i] = true;
+			for (const RenderGraphUse& use : pass.uses) {
+				if (!describeAccess(use.access).write) {
+					needed[use.resource] = true;
+				}
+			}
+		}
+
+		graph.order.clear();
+		for (uint32_t i = 0; i < graph.passCount; ++i) {
+			if (alive[i]) {
+				graph.order.push_back(i);
+			}
+		}
+		graph.culledPasses = graph.passCount - static_cast<uint32_t>(graph.order.size());
+	}
+
+	// Returns true if a transient's pass range changed, which needs its memory re-planned.
+	bool assignTransientLifetimes(RenderGraph& graph, VulkanEngine* engine)
+	{
+		bool changed = false;
+		for (uint32_t r = 0; r < graph.resourceCount; ++r) {
+			const RenderGraphResourceInfo& resource = graph.resources[r];
+			if (resource.transient == UINT32_MAX) {
+				continue;
+			}
+
+			uint32_t first = UINT32_MAX;
+			uint32_t last = 0;
+			for (uint32_t position = 0; position < graph.order.size(); ++position) {
+				for (const RenderGraphUse& use : graph.passes[graph.order[position]].uses) {
+					if (use.resource == r) {
+						first = std::min(first, position);
+						last = std::max(last, position);
+					}
+				}
+			}
+			// Unused this frame: keep the current placement rather than churn memory.
+			if (first == UINT32_MAX) {
+				continue;
+			}
+
+			TransientImageDesc& desc = engine->_vk.transientImages.images.at(resource.transient).desc;
+			if (desc.firstPass != first || desc.lastPass != last) {
+				desc.firstPass = first;
+				desc.lastPass = last;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	RenderGraphQueue passQueue(const RenderGraphPass& pass, VulkanEngine* engine)
+	{
+		return engine->_vk.asyncCompute ? pass.queue : RenderGraphQueue::Graphics;
+	}
+
+	void waitForBatch(RenderGraphBatch& batch, uint32_t other)
+	{
+		if (batch.waitBatch == UINT32_MAX || other > batch.waitBatch) {
+			batch.waitBatch = other;
+		}
+	}
+
+	// Splits the compiled order into runs of passes on one queue, and works out which batch
+	// on the other queue each run has to wait for.
+	void buildBatches(RenderGraph& graph, VulkanEngine* engine)
+	{
+		graph.batches.clear();
+		for (uint32_t position = 0; position < graph.order.size(); ++position) {
+			RenderGraphQueue queue = passQueue(graph.passes[graph.order[position]], engine);
+			if (graph.batches.empty() || graph.batches.back().queue != queue) {
+				RenderGraphBatch& batch = graph.batches.emplace_back();
+				batch.queue = queue;
+				batch.firstPass = position;
+			}
+			graph.batches.back().passCount++;
+		}
+		if (graph.batches.empty() || graph.batches.back().queue != RenderGraphQueue::Graphics) {
+			throw std::runtime_error("Render graph has to end with a graphics pass!");
+		}
+
+		// Latest batch that used each resource, per queue.
+		std::vector<std::array<uint32_t, 2>> lastBatch(graph.resourceCount, { UINT32_MAX, UINT32_MAX });
+		uint32_t lastCompute = UINT32_MAX;
+		for (uint32_t b = 0; b < graph.batches.size(); ++b) {
+			RenderGraphBatch& batch = graph.batches[b];
+			size_t queue = static_cast<size_t>(batch.queue);
+			for (uint32_t position = batch.firstPass; position < batch.firstPass + batch.passCount; ++position) {
+				const RenderGraphPass& pass = graph.passes[graph.order[position]];
+				for (const RenderGraphUse& use : pass.uses) {
+					std::array<uint32_t, 2>& last = lastBatch[use.resource];
+					if (batch.queue == RenderGraphQueue::AsyncCompute) {
+						// Alias groups are only synchronized within the graphics queue.
+						if (graph.resources[use.resource].transient != UINT32_MAX) {
+							throw std::runtime_error("Async compute pass '" + pass.name + "' uses a transient image!");
+						}
+						batch.waitPreviousFrame |= last[0] == UINT32_MAX && last[1] == UINT32_MAX;
+					}
+					if (last[1 - queue] != UINT32_MAX) {
+						waitForBatch(batch, last[1 - queue]);
+					}
+					last[queue] = b;
+				}
+			}
+			if (batch.queue == RenderGraphQueue::AsyncCompute) {
+				lastCompute = b;
+			}
+		}
+
+		// The last graphics submission signals the value waitForFrameSlot waits for, so it
+		// joins the frame's compute work; reusing the slot then covers both queues.
+		if (lastCompute != UINT32_MAX) {
+			waitForBatch(graph.batches.back(), lastCompute);
+		}
+	}
+
+	// Primary command buffers for every batch but the first graphics one, which the caller provides.
+	VkCommandBuffer beginBatchCommandBuffer(RenderGraphQueue queue, VulkanEngine* engine)
+	{
+		RenderGraph& graph = engine->_vk.renderGraph;
+		size_t index = static_cast<size_t>(queue);
+		std::vector<VkCommandBuffer>& commandBuffers = graph.batchCommandBuffers[engine->_vk.currentFrame][index];
+		uint32_t& used = graph.batchCommandBuffersUsed[index];
+		if (used == commandBuffers.size()) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = queue == RenderGraphQueue::AsyncCompute ? engine->_vk.computeCommandPool : engine->_vk.commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(engine->_vk.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate render graph command buffer!");
+			}
+			commandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = commandBuffers[used++];
+
+		// Both pools allow resetting single buffers, so beginning resets it.
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording render graph command buffer!");
+		}
+		return commandBuffer;
+	}
+
+	/**
+	 * @brief First use of an image this frame. Frame-local contents are discarded; transients
+	 * also wait for every image aliasing their memory, and imported images for the stage
+	 * their semaphore wait unblocks.
+	 */
+	void beginImageUse(const RenderGraphResourceInfo& resource, VkImage image, VulkanEngine* engine)
+	{
+		if (resource.transient != UINT32_MAX) {
+			const TransientImages& transients = engine->_vk.transientImages;
+			uint32_t group = transients.images[resource.transient].aliasGroup;
+			VkPipelineStageFlags2 aliasStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 aliasAccess = VK_ACCESS_2_NONE;
+			for (const TransientImage& alias : transients.images) {
+				if (group == UINT32_MAX || alias.aliasGroup != group || alias.image == image) {
+					continue;
+				}
+				if (const ImageState* state = findImageState(alias.image, engine)) {
+					aliasStages |= state->writeStages | state->readStages;
+					aliasAccess |= state->writeAccess;
+				}
+			}
+			discardImage(image, aliasStages, aliasAccess, engine);
+		} else if (resource.discard) {
+			discardImage(image, resource.waitStages, VK_ACCESS_2_NONE, engine);
+		}
+	}
+
+} // namespace
+
+void beginRenderGraph(VulkanEngine* engine)
+{
+	RenderGraph& graph = engine->_vk.renderGraph;
+	graph.resourceCount = 0;
+	graph.passCount = 0;
+	graph.batchCommandBuffersUsed = {};
+}
+
+RenderGraphResource importGraphImage(const char* name, VkImage image, const VkImageSubresourceRange& range,
+		bool discard, VkPipelineStageFlags2 waitStages, VulkanEngine* engine)
+{
+	RenderGraphResource handle = addResource(name, engine);
+	RenderGraphResourceInfo& resource = engine->_vk.renderGraph.resources[handle];
+	resource.image = image;
+	resource.range = range;
+	resource.discard = discard;
+	resource.waitStages = waitStages;
+	return handle;
+}
+
+RenderGraphResource importGraphBuffer(const char* name, VkBuffer buffer, VulkanEngine* engine)
+{
+	RenderGraphResource handle = addResource(name, engine);
+	RenderGraphResourceInfo& resource = engine->_vk.renderGraph.resources[handle];
+	resource.isBuffer = true;
+	resource.buffer = buffer;
+	return handle;
+}
+
+RenderGraphResource useGraphTransient(const char* name, TransientImageHandle transient, const VkImageSubresourceRange& range,
+		VulkanEngine* engine)
+{
+	RenderGraphResource handle = addResource(name, engine);
+	RenderGraphResourceInfo& resource = engine->_vk.renderGraph.resources[handle];
+	resource.transient = transient;
+	resource.range = range;
+	resource.discard = true;
+	return handle;
+}
+
+uint32_t addGraphPass(const char* name, bool sideEffects, std::function<void(VkCommandBuffer)> record, VulkanEngine* engine)
+{
+	RenderGraph& graph = engine->_vk.renderGraph;
+	if (graph.passCount == graph.passes.size()) {
+		graph.passes.emplace_back();
+	}
+
+	RenderGraphPass& pass = graph.passes[graph.passCount];
+	pass.name = name;
+	pass.uses.clear();
+	pass.sideEffects = sideEffects;
+	pass.queue = RenderGraphQueue::Graphics;
+	pass.record = std::move(record);
+	return graph.passCount++;
+}
+
+void setGraphPassQueue(uint32_t pass, RenderGraphQueue queue, VulkanEngine* engine)
+{
+	engine->_vk.renderGraph.passes.at(pass).queue = queue;
+}
+
+void useGraphResource(uint32_t pass, RenderGraphResource resource, ResourceAccess access, VulkanEngine* engine)
+{
+	engine->_vk.renderGraph.passes.at(pass).uses.push_back({ resource, access });
+}
+
+void compileRenderGraph(VulkanEngine* engine)
+{
+	RenderGraph& graph = engine->_vk.renderGraph;
+	uint64_t topology = hashTopology(graph);
+	if (graph.compilations > 0 && topology == graph.compiledTopology) {
+		return;
+	}
+	graph.compiledTopology = topology;
+	graph.compilations++;
+
+	cullPasses(graph);
+	buildBatches(graph, engine);
+	if (assignTransientLifetimes(graph, engine)) {
+		rebuildFrameAttachments(engine);
+	}
+
+	std::string passes;
+	for (uint32_t index : graph.order) {
+		const RenderGraphPass& pass = graph.passes[index];
+		passes += (passes.empty() ? "" : ", ") + pass.name + (passQueue(pass, engine) == RenderGraphQueue::AsyncCompute ? " (async)" : "");
+	}
+	Logger::Info("Render graph compiled: " + passes + " (" + std::to_string(graph.culledPasses) + " culled, "
+		+ std::to_string(graph.batches.size()) + " submissions)");
+}
+
+void executeRenderGraph(VkCommandBuffer commandBuffer, VulkanEngine* engine)
+{
+	RenderGraph& graph = engine->_vk.renderGraph;
+	BarrierBatch barriers(getFrameArena(engine));
+	bool firstGraphics = true;
+
+	for (RenderGraphBatch& batch : graph.batches) {
+		if (batch.queue == RenderGraphQueue::Graphics && firstGraphics) {
+			batch.commandBuffer = commandBuffer;
+			firstGraphics = false;
+		} else {
+			batch.commandBuffer = beginBatchCommandBuffer(batch.queue, engine);
+		}
+
+		for (uint32_t position = batch.firstPass; position < batch.firstPass + batch.passCount; ++position) {
+			RenderGraphPass& pass = graph.passes[graph.order[position]];
+			for (const RenderGraphUse& use : pass.uses) {
+				RenderGraphResourceInfo& resource = graph.resources[use.resource];
+				// Coming from the other queue, or from the previous frame into a compute batch that waited for it.
+				bool handedOver = resource.used ? resource.lastQueue != batch.queue : batch.queue == RenderGraphQueue::AsyncCompute;
+				bool firstUse = !resource.used;
+				resource.used = true;
+				resource.lastQueue = batch.queue;
+
+				if (resource.isBuffer) {
+					if (handedOver) {
+						settleBuffer(resource.buffer, engine);
+					}
+					requireBufferAccess(barriers, resource.buffer, use.access, engine);
+					continue;
+				}
+
+				VkImage image = resource.transient != UINT32_MAX ? getTransientImage(resource.transient, engine) : resource.image;
+				if (firstUse) {
+					beginImageUse(resource, image, engine);
+				}
+				if (handedOver) {
+					settleImage(image, engine);
+				}
+				requireImageAccess(barriers, image, resource.range, use.access, engine);
+			}
+
+			flushBarriers(batch.commandBuffer, barriers, engine);
+			pass.record(batch.commandBuffer);
+		}
+
+		if (batch.commandBuffer != commandBuffer && vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record render graph command buffer!");
+		}
+	}
+}
+
+void submitRenderGraph(VkSemaphore acquireSemaphore, VkSemaphore presentSemaphore, VulkanEngine* engine)
+{
+	VulkanContext& vk = engine->_vk;
+	RenderGraph& graph = vk.renderGraph;
+	// Everything the previous frame submitted to the graphics queue.
+	uint64_t previousGraphics = vk.graphicsTimeline.value;
+	uint32_t lastBatch = static_cast<uint32_t>(graph.batches.size() - 1);
+	bool firstGraphics = true;
+
+	for (uint32_t b = 0; b <= lastBatch; ++b) {
+		RenderGraphBatch& batch = graph.batches[b];
+		bool compute = batch.queue == RenderGraphQueue::AsyncCompute;
+
+		std::array<VkSemaphoreSubmitInfo, 4> waits{};
+		uint32_t waitCount = 0;
+		auto addWait = [&](VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags2 stages) {
+			VkSemaphoreSubmitInfo& wait = waits[waitCount++];
+			wait.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			wait.semaphore = semaphore;
+			wait.value = value;
+			wait.stageMask = stages;
+		};
+
+		// Cross-queue waits block every stage: the other queue's accesses are not tracked here.
+		if (batch.waitBatch != UINT32_MAX) {
+			const RenderGraphBatch& other = graph.batches[batch.waitBatch];
+			QueueTimeline& timeline = other.queue == RenderGraphQueue::AsyncCompute ? vk.computeTimeline : vk.graphicsTimeline;
+			addWait(timeline.semaphore, other.signalValue, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+		}
+		if (batch.waitPreviousFrame && previousGraphics > 0) {
+			addWait(vk.graphicsTimeline.semaphore, previousGraphics, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+		}
+		// Upload acquires and the backbuffer's first use are in the first graphics command buffer.
+		if (!compute && firstGraphics) {
+			addWait(acquireSemaphore, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+			if (vk.uploadWaitValue > 0) {
+				addWait(vk.transferTimeline.semaphore, vk.uploadWaitValue, UPLOAD_ACQUIRE_STAGES);
+			}
+			firstGraphics = false;
+		}
+
+		// The last batch is always on the graphics queue; it signals present and marks the frame finished.
+		QueueTimeline& timeline = compute ? vk.computeTimeline : vk.graphicsTimeline;
+		batch.signalValue = b == lastBatch ? beginFrameSubmission(engine) : nextTimelineValue(timeline);
+
+		std::array<VkSemaphoreSubmitInfo, 2> signals{};
+		uint32_t signalCount = b == lastBatch ? 2 : 1;
+		for (VkSemaphoreSubmitInfo& signal : signals) {
+			signal.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			signal.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		}
+		signals[0].semaphore = timeline.semaphore;
+		signals[0].value = batch.signalValue;
+		signals[1].semaphore = presentSemaphore;
+
+		VkCommandBufferSubmitInfo commandBufferInfo{};
+		commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+		commandBufferInfo.commandBuffer = batch.commandBuffer;
+
+		VkSubmitInfo2 submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+		submitInfo.waitSemaphoreInfoCount = waitCount;
+		submitInfo.pWaitSemaphoreInfos = waits.data();
+		submitInfo.commandBufferInfoCount = 1;
+		submitInfo.pCommandBufferInfos = &commandBufferInfo;
+		submitInfo.signalSemaphoreInfoCount = signalCount;
+		submitInfo.pSignalSemaphoreInfos = signals.data();
+
+		if (vkQueueSubmit2(compute ? vk.computeQueue : vk.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit draw command buffer!");
+		}
+	}
+}
@@ -1,41 +1,101 @@
 #include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanRenderPass.hpp"
+#include "vulkan/VulkanTransient.hpp"
+#include "vulkan/VulkanDeletionQueue.hpp"
 #include <stdexcept>
 
-void createRenderPass(VulkanEngine* engine)
+VkFormat findDepthFormat(VulkanEngine* engine)
 {
-	VkAttachmentDescription colorAttachment = {};
-	colorAttachment.format = engine->_vk.swapchainImageFormat;
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	for (VkFormat format : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT}) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(engine->_vk.physicalDevice, format, &properties);
+		if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+			return format;
+		}
+	}
+	throw std::runtime_error("No supported depth format!");
+}
+
+namespace {
+
+	// The scene pass with the given load op for both attachments. Load and store ops do not
+	// affect render pass compatibility, so every variant shares framebuffers and pipelines.
+	VkRenderPass createScenePass(VkAttachmentLoadOp loadOp, VkAttachmentStoreOp depthStoreOp, VulkanEngine* engine)
+	{
+		VkAttachmentDescription colorAttachment = {};
+		colorAttachment.format = engine->_vk.swapchainImageFormat;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = loadOp;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		// The render graph transitions the attachments around the pass, so it never changes layouts itself.
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		VkAttachmentReference colorAttachmentRef = {};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		VkAttachmentDescription depthAttachment = {};
+		depthAttachment.format = engine->_vk.depthFormat;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = loadOp;
+		depthAttachment.storeOp = depthStoreOp;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-	VkAttachmentReference colorAttachmentRef = {};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkAttachmentReference depthAttachmentRef = {};
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-	VkRenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &colorAttachment;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
+		VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
 
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 2;
+		renderPassInfo.pAttachments = attachments;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		// Ordering against earlier work (the acquire wait, the previous frame's depth tests and
+		// aliased images) comes from the barriers the render graph issues in front of the pass.
+		renderPassInfo.dependencyCount = 0;
 
-	if (vkCreateRenderPass(engine->_vk.device, &renderPassInfo, nullptr, &engine->_vk.renderPass) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create render pass!");
+		VkRenderPass renderPass;
+		if (vkCreateRenderPass(engine->_vk.device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render pass!");
+		}
+		return renderPass;
 	}
+
+} // namespace
+
+void createRenderPass(VulkanEngine* engine)
+{
+	engine->_vk.depthFormat = findDepthFormat(engine);
+
+	// Depth never leaves the full scene pass, so it is neither loaded nor stored.
+	engine->_vk.renderPass = createScenePass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE, engine);
+	engine->_vk.earlyRenderPass = createScenePass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, engine);
+	engine->_vk.lateRenderPass = createScenePass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_STORE_OP_DONT_CARE, engine);
+}
+
+void destroyRenderPasses(VulkanEngine* engine)
+{
+	vkDestroyRenderPass(engine->_vk.device, engine->_vk.lateRenderPass, nullptr);
+	vkDestroyRenderPass(engine->_vk.device, engine->_vk.earlyRenderPass, nullptr);
+	vkDestroyRenderPass(engine->_vk.device, engine->_vk.renderPass, nullptr);
 }
 
 void createFramebuffers(VulkanEngine* engine)
@@ -43,12 +103,12 @@ void createFramebuffers(VulkanEngine* engine)
 	engine->_vk.swapchainFramebuffers.resize(engine->_vk.swapchainImageViews.size());
 
 	for (size_t i = 0; i < engine->_vk.swapchainImageViews.size(); i++) {
-		VkImageView attachments[] = {engine->_vk.swapchainImageViews[i]};
+		VkImageView attachments[] = {engine->_vk.swapchainImageViews[i], getTransientImageView(engine->_vk.depthImage, engine)};
 
 		VkFramebufferCreateInfo framebufferInfo = {};
 		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		framebufferInfo.renderPass = engine->_vk.renderPass;
-		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.attachmentCount = 2;
 		framebufferInfo.pAttachments = attachments;
 		framebufferInfo.width = engine->_vk.swapchainExtent.width;
 		framebufferInfo.height = engine->_vk.swapchainExtent.height;
@@ -59,3 +119,43 @@ void createFramebuffers(VulkanEngine* engine)
 		}
 	}
 }
+
+void declareFrameAttachments(VulkanEngine* engine)
+{
+	TransientImageDesc depth{};
+	depth.name = "depth";
+	depth.format = engine->_vk.depthFormat;
+	depth.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	depth.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (depth.format != VK_FORMAT_D32_SFLOAT) {
+		depth.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+
+	// The depth pyramid is reduced from depth with a sampler, which a combined depth/stencil
+	// view cannot provide. Sampling also rules out a lazily allocated depth buffer.
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(engine->_vk.physicalDevice, depth.format, &properties);
+	GpuCulling& culling = engine->_vk.gpuCulling;
+	culling.occlusionSupported = culling.supported && depth.format == VK_FORMAT_D32_SFLOAT
+		&& (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+	if (culling.occlusionSupported) {
+		depth.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	}
+	engine->_vk.depthImage = declareTransientImage(depth, engine);
+}
+
+void rebuildFrameAttachments(VulkanEngine* engine)
+{
+	for (VkFramebuffer& framebuffer : engine->_vk.swapchainFramebuffers) {
+		deferDestroyFramebuffer(framebuffer, engine);
+	}
+	releaseTransientImages(engine);
+	buildTransientImages(engine);
+	createFramebuffers(engine);
+}
+
+VkImageSubresourceRange depthRange(VulkanEngine* engine)
+{
+	VkImageAspectFlags aspect = engine->_vk.transientImages.images.at(engine->_vk.depthImage).desc.aspect;
+	return { aspect, 0, 1, 0, 1 };
+}
@@ -0,0 +1,146 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanSampler.hpp"
+#include "Assets/GltfLoader.hpp"
+#include "Logger.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+	SamplerKey makeSamplerKey(const VkSamplerCreateInfo& info)
+	{
+		SamplerKey key{};
+		key.magFilter = info.magFilter;
+		key.minFilter = info.minFilter;
+		key.mipmapMode = info.mipmapMode;
+		key.addressModeU = info.addressModeU;
+		key.addressModeV = info.addressModeV;
+		key.addressModeW = info.addressModeW;
+		key.mipLodBias = info.mipLodBias;
+		key.anisotropyEnable = info.anisotropyEnable;
+		// maxAnisotropy is ignored by the driver when anisotropy is off; don't let it split entries.
+		key.maxAnisotropy = info.anisotropyEnable ? info.maxAnisotropy : 1.0f;
+		key.compareEnable = info.compareEnable;
+		key.compareOp = info.compareEnable ? info.compareOp : VK_COMPARE_OP_NEVER;
+		key.minLod = info.minLod;
+		key.maxLod = info.maxLod;
+		key.borderColor = info.borderColor;
+		key.unnormalizedCoordinates = info.unnormalizedCoordinates;
+		return key;
+	}
+
+	VkSamplerAddressMode toAddressMode(fastgltf::Wrap wrap)
+	{
+		switch (wrap) {
+		case fastgltf::Wrap::ClampToEdge:
+			return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		case fastgltf::Wrap::MirroredRepeat:
+			return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		case fastgltf::Wrap::Repeat:
+		default:
+			return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		}
+	}
+
+	VkFilter toFilter(fastgltf::Filter filter)
+	{
+		switch (filter) {
+		case fastgltf::Filter::Nearest:
+		case fastgltf::Filter::NearestMipMapNearest:
+		case fastgltf::Filter::NearestMipMapLinear:
+			return VK_FILTER_NEAREST;
+		default:
+			return VK_FILTER_LINEAR;
+		}
+	}
+
+	VkSamplerMipmapMode toMipmapMode(fastgltf::Filter filter)
+	{
+		switch (filter) {
+		case fastgltf::Filter::NearestMipMapNearest:
+		case fastgltf::Filter::LinearMipMapNearest:
+			return VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		default:
+			return VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		}
+	}
+
+} // namespace
+
+VkSamplerCreateInfo makeSamplerCreateInfo(VkFilter filter, VkSamplerMipmapMode mipmapMode, VkSamplerAddressMode addressMode)
+{
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = filter;
+	samplerInfo.minFilter = filter;
+	samplerInfo.mipmapMode = mipmapMode;
+	samplerInfo.addressModeU = addressMode;
+	samplerInfo.addressModeV = addressMode;
+	samplerInfo.addressModeW = addressMode;
+	samplerInfo.maxAnisotropy = 1.0f;
+	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	return samplerInfo;
+}
+
+VkSampler getSampler(const VkSamplerCreateInfo& samplerInfo, VulkanEngine* engine)
+{
+	if (samplerInfo.pNext != nullptr || samplerInfo.flags != 0) {
+		throw std::runtime_error("Sampler cache does not support pNext chains or sampler flags!");
+	}
+
+	SamplerCache& cache = engine->_vk.samplerCache;
+	SamplerKey key = makeSamplerKey(samplerInfo);
+	if (auto it = cache.samplers.find(key); it != cache.samplers.end()) {
+		cache.hits++;
+		return it->second;
+	}
+
+	VkSampler sampler;
+	if (vkCreateSampler(engine->_vk.device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create sampler!");
+	}
+
+	cache.samplers.emplace(key, sampler);
+	cache.misses++;
+	return sampler;
+}
+
+void destroySamplerCache(VulkanEngine* engine)
+{
+	SamplerCache& cache = engine->_vk.samplerCache;
+	for (auto& [key, sampler] : cache.samplers) {
+		vkDestroySampler(engine->_vk.device, sampler, nullptr);
+	}
+
+	Logger::Info("Sampler cache: " + std::to_string(cache.samplers.size()) + " samplers for "
+		+ std::to_string(cache.hits + cache.misses) + " requests");
+	cache = SamplerCache{};
+	engine->_vk.sceneSamplers.clear();
+}
+
+void createModelSamplers(const Assets::GltfModel& model, VulkanEngine* engine)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(engine->_vk.physicalDevice, &properties);
+
+	auto makeSceneSampler = [&](const std::string& name, VkSamplerCreateInfo samplerInfo) {
+		samplerInfo.anisotropyEnable = samplerInfo.minFilter == VK_FILTER_LINEAR ? VK_TRUE : VK_FALSE;
+		samplerInfo.maxAnisotropy = samplerInfo.anisotropyEnable ? properties.limits.maxSamplerAnisotropy : 1.0f;
+		engine->_vk.sceneSamplers.push_back({name, getSampler(samplerInfo, engine), samplerInfo.addressModeU, samplerInfo.addressModeV});
+	};
+
+	for (const auto& gltfSampler : model.GetGltfAsset().samplers) {
+		VkSamplerCreateInfo samplerInfo = makeSamplerCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+		samplerInfo.magFilter = toFilter(gltfSampler.magFilter.value_or(fastgltf::Filter::Linear));
+		samplerInfo.minFilter = toFilter(gltfSampler.minFilter.value_or(fastgltf::Filter::LinearMipMapLinear));
+		samplerInfo.mipmapMode = toMipmapMode(gltfSampler.minFilter.value_or(fastgltf::Filter::LinearMipMapLinear));
+		samplerInfo.addressModeU = toAddressMode(gltfSampler.wrapS);
+		samplerInfo.addressModeV = toAddressMode(gltfSampler.wrapT);
+		makeSceneSampler(std::string(gltfSampler.name), samplerInfo);
+	}
+
+	// Textures without a sampler use repeat wrapping and auto filtering (glTF 2.0, 5.26).
+	makeSceneSampler("default", makeSamplerCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT));
+}
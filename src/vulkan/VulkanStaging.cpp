@@ -0,0 +1,406 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanStaging.hpp"
+#include "vulkan/VulkanBuffer.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanCommandBuffer.hpp"
+#include "vulkan/VulkanFrameAllocator.hpp"
+#include "vulkan/VulkanDeletionQueue.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	QueueTimeline& timelineFor(UploadQueue queue, VulkanEngine* engine)
+	{
+		return queue == UploadQueue::Transfer ? engine->_vk.transferTimeline : engine->_vk.graphicsTimeline;
+	}
+
+	// Transfer uploads only need queue family ownership transfers when they really run on another family.
+	bool releasesToGraphics(const UploadBatch& batch, VulkanEngine* engine)
+	{
+		return batch.queue == UploadQueue::Transfer && engine->_vk.transferQueueFamily != engine->_vk.graphicsQueueFamily;
+	}
+
+	bool isSubmissionComplete(const StagingSubmission& submission, VulkanEngine* engine)
+	{
+		uint64_t value = 0;
+		vkGetSemaphoreCounterValue(engine->_vk.device, timelineFor(submission.queue, engine).semaphore, &value);
+		return value >= submission.timelineValue;
+	}
+
+	void waitForOldest(StagingRing& ring, VulkanEngine* engine)
+	{
+		const StagingSubmission& submission = ring.inFlight.front();
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &timelineFor(submission.queue, engine).semaphore;
+		waitInfo.pValues = &submission.timelineValue;
+		vkWaitSemaphores(engine->_vk.device, &waitInfo, UINT64_MAX);
+	}
+
+	void retireOldest(StagingRing& ring, VulkanEngine* engine)
+	{
+		StagingSubmission& submission = ring.inFlight.front();
+		ring.tail = submission.end;
+
+		recycleOneShotCommandBuffer(submission.queue, submission.commandBuffer, engine);
+		for (auto& buffer : submission.overflowBuffers) {
+			destroyBuffer(buffer, engine);
+		}
+
+		ring.inFlight.pop_front();
+		ring.completedSubmissions++;
+	}
+
+	// Deferred image copies go out between the batch's two barrier batches.
+	void recordImageCopies(UploadBatch& batch, VulkanEngine* engine)
+	{
+		flushBarriers(batch.commandBuffer, batch.copyBarriers, engine);
+		for (const PendingImageCopy& copy : batch.imageCopies) {
+			vkCmdCopyBufferToImage(batch.commandBuffer, copy.buffer, copy.image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+		}
+		batch.imageCopies.clear();
+		flushBarriers(batch.commandBuffer, batch.finishBarriers, engine);
+	}
+
+	// Submits the batch's current command buffer and queues the acquire half of its ownership transfers.
+	uint64_t flushBatch(UploadBatch& batch, VulkanEngine* engine)
+	{
+		recordImageCopies(batch, engine);
+		uint64_t submission = endSingleTimeCommands(batch.commandBuffer, batch.queue, engine);
+		batch.submissionCount++;
+
+		if (!batch.imageAcquires.empty() || !batch.bufferAcquires.empty()) {
+			StagingRing& ring = engine->_vk.stagingRing;
+			UploadAcquire acquire{};
+			acquire.submission = submission;
+			acquire.timelineValue = engine->_vk.transferTimeline.value;
+			acquire.imageBarriers = std::move(batch.imageAcquires);
+			acquire.bufferBarriers = std::move(batch.bufferAcquires);
+			ring.pendingAcquires.push_back(std::move(acquire));
+
+			batch.imageAcquires.clear();
+			batch.bufferAcquires.clear();
+		}
+		return submission;
+	}
+
+} // namespace
+
+void createStagingRing(VkDeviceSize size, VulkanEngine* engine)
+{
+	StagingRing& ring = engine->_vk.stagingRing;
+	// Keep the wrap point aligned for every copy alignment we hand out.
+	ring.size = alignUp(size, 256);
+	ring.buffer = createBuffer(ring.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, engine);
+	ring.mapped = static_cast<uint8_t*>(ring.buffer.allocationInfo.pMappedData);
+
+	if (engine->_vk.transferQueueFamily != engine->_vk.graphicsQueueFamily) {
+		Logger::Info("Uploads run on dedicated transfer queue family " + std::to_string(engine->_vk.transferQueueFamily));
+	} else {
+		Logger::Info("No separate transfer queue family; uploads share the graphics queue");
+	}
+}
+
+void destroyStagingRing(VulkanEngine* engine)
+{
+	StagingRing& ring = engine->_vk.stagingRing;
+	while (!ring.inFlight.empty()) {
+		waitForOldest(ring, engine);
+		retireOldest(ring, engine);
+	}
+	for (auto& buffer : ring.pendingOverflow) {
+		destroyBuffer(buffer, engine);
+	}
+	destroyBuffer(ring.buffer, engine);
+
+	Logger::Info("Staging ring: " + std::to_string(ring.bytesStaged / (1024 * 1024)) + " MiB in "
+		+ std::to_string(ring.submissions) + " submissions, " + std::to_string(ring.stalls) + " stalls, "
+		+ std::to_string(ring.overflowUploads) + " oversized uploads, "
+		+ std::to_string(ring.acquireWaits) + " frames waited on transfers, "
+		+ std::to_string(engine->_vk.oneShotPools[0].allocated + engine->_vk.oneShotPools[1].allocated) + " command buffers allocated");
+	ring = StagingRing{};
+}
+
+StagingAllocation reserveStaging(VkDeviceSize size, VkDeviceSize alignment, VulkanEngine* engine)
+{
+	StagingRing& ring = engine->_vk.stagingRing;
+	ring.bytesStaged += size;
+
+	if (size > ring.size) {
+		AllocatedBuffer buffer = createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, engine);
+		ring.pendingOverflow.push_back(buffer);
+		ring.overflowUploads++;
+		return {buffer.buffer, 0, buffer.allocationInfo.pMappedData};
+	}
+
+	retireStaging(engine);
+	while (true) {
+		uint64_t start = alignUp(ring.head, alignment);
+		if (start % ring.size + size > ring.size) {
+			// Skip to the start of the buffer; the skipped bytes are released with this submission.
+			start = alignUp(start, ring.size);
+		}
+
+		if (start + size - ring.tail <= ring.size) {
+			ring.head = start + size;
+			return {ring.buffer.buffer, start % ring.size, ring.mapped + start % ring.size};
+		}
+
+		if (ring.inFlight.empty()) {
+			throw std::runtime_error("Staging ring too small for the uploads recorded before the next submission!");
+		}
+
+		ring.stalls++;
+		waitForOldest(ring, engine);
+		retireOldest(ring, engine);
+	}
+}
+
+uint64_t trackStagingSubmission(UploadQueue queue, uint64_t timelineValue, VkCommandBuffer commandBuffer, VulkanEngine* engine)
+{
+	StagingRing& ring = engine->_vk.stagingRing;
+	ring.inFlight.push_back({ring.head, queue, timelineValue, commandBuffer, std::move(ring.pendingOverflow)});
+	ring.pendingOverflow.clear();
+	return ++ring.submissions;
+}
+
+void retireStaging(VulkanEngine* engine)
+{
+	StagingRing& ring = engine->_vk.stagingRing;
+	while (!ring.inFlight.empty() && isSubmissionComplete(ring.inFlight.front(), engine)) {
+		retireOldest(ring, engine);
+	}
+}
+
+bool isUploadComplete(uint64_t submission, VulkanEngine* engine)
+{
+	retireStaging(engine);
+	return engine->_vk.stagingRing.completedSubmissions >= submission;
+}
+
+void waitForUpload(uint64_t submission, VulkanEngine* engine)
+{
+	StagingRing& ring = engine->_vk.stagingRing;
+	while (ring.completedSubmissions < submission) {
+		waitForOldest(ring, engine);
+		retireOldest(ring, engine);
+	}
+}
+
+void requireUpload(uint64_t submission, VulkanEngine* engine)
+{
+	for (UploadAcquire& acquire : engine->_vk.stagingRing.pendingAcquires) {
+		if (acquire.submission <= submission) {
+			acquire.required = true;
+		}
+	}
+}
+
+uint64_t recordUploadAcquires(VkCommandBuffer commandBuffer, VulkanEngine* engine)
+{
+	StagingRing& ring = engine->_vk.stagingRing;
+	if (ring.pendingAcquires.empty()) {
+		return 0;
+	}
+
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(engine->_vk.device, engine->_vk.transferTimeline.semaphore, &completed);
+
+	// Acquires are ordered by timeline value, so taking everything up to the last required or
+	// finished entry never waits longer than that entry already does.
+	size_t count = 0;
+	for (size_t i = 0; i < ring.pendingAcquires.size(); ++i) {
+		if (ring.pendingAcquires[i].required || ring.pendingAcquires[i].timelineValue <= completed) {
+			count = i + 1;
+		}
+	}
+	if (count == 0) {
+		return 0;
+	}
+
+	BarrierBatch acquires(getFrameArena(engine));
+	for (size_t i = 0; i < count; ++i) {
+		const UploadAcquire& acquire = ring.pendingAcquires[i];
+		acquires.images.insert(acquires.images.end(), acquire.imageBarriers.begin(), acquire.imageBarriers.end());
+		acquires.buffers.insert(acquires.buffers.end(), acquire.bufferBarriers.begin(), acquire.bufferBarriers.end());
+	}
+	uint64_t waitValue = ring.pendingAcquires[count - 1].timelineValue;
+	ring.pendingAcquires.erase(ring.pendingAcquires.begin(), ring.pendingAcquires.begin() + count);
+
+	flushBarriers(commandBuffer, acquires, engine);
+
+	if (waitValue > completed) {
+		ring.acquireWaits++;
+	}
+	return waitValue;
+}
+
+UploadBatch beginUploadBatch(UploadQueue queue, VulkanEngine* engine)
+{
+	UploadBatch batch{};
+	batch.queue = queue;
+	batch.commandBuffer = beginSingleTimeCommands(queue, engine);
+	return batch;
+}
+
+StagingAllocation stageUpload(UploadBatch& batch, VkDeviceSize size, VkDeviceSize alignment, VulkanEngine* engine)
+{
+	// Keep the unsubmitted part of the batch small enough that the ring can always make room for it.
+	if (batch.stagedBytes > 0 && batch.stagedBytes + size > engine->_vk.stagingRing.size / 2) {
+		flushBatch(batch, engine);
+		batch.commandBuffer = beginSingleTimeCommands(batch.queue, engine);
+		batch.stagedBytes = 0;
+	}
+
+	batch.stagedBytes += size;
+	return reserveStaging(size, alignment, engine);
+}
+
+void uploadBuffer(UploadBatch& batch, const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset, VulkanEngine* engine)
+{
+	StagingAllocation staging = stageUpload(batch, size, 4, engine);
+	memcpy(staging.data, data, static_cast<size_t>(size));
+
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(batch.commandBuffer, staging.buffer, dstBuffer, 1, &copyRegion);
+
+	// Same-family uploads are made visible by the memory barrier at the end of the submission.
+	if (releasesToGraphics(batch, engine)) {
+		VkBufferMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = engine->_vk.transferQueueFamily;
+		barrier.dstQueueFamilyIndex = engine->_vk.graphicsQueueFamily;
+		barrier.buffer = dstBuffer;
+		barrier.offset = dstOffset;
+		barrier.size = size;
+		batch.finishBarriers.buffers.push_back(barrier);
+
+		// The source stages match the semaphore wait stages so the acquire is ordered after the wait.
+		barrier.srcStageMask = UPLOAD_ACQUIRE_STAGES;
+		barrier.srcAccessMask = VK_ACCESS_2_NONE;
+		barrier.dstStageMask = UPLOAD_ACQUIRE_STAGES;
+		barrier.dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT;
+		batch.bufferAcquires.push_back(barrier);
+	}
+}
+
+void finishImageUpload(UploadBatch& batch, VkImage image, uint32_t mipLevels, uint32_t layerCount, VulkanEngine* engine)
+{
+	if (!releasesToGraphics(batch, engine)) {
+		requireImageAccess(batch.finishBarriers, image, colorRange(mipLevels, layerCount), ResourceAccess::FragmentShaderRead, engine);
+		return;
+	}
+
+	// Release half of the ownership transfer; the layout transition happens once, here.
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = engine->_vk.transferQueueFamily;
+	barrier.dstQueueFamilyIndex = engine->_vk.graphicsQueueFamily;
+	barrier.image = image;
+	barrier.subresourceRange = colorRange(mipLevels, layerCount);
+	batch.finishBarriers.images.push_back(barrier);
+
+	barrier.srcStageMask = UPLOAD_ACQUIRE_STAGES;
+	barrier.srcAccessMask = VK_ACCESS_2_NONE;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
+	batch.imageAcquires.push_back(barrier);
+
+	// Frames cannot sample the image before they have acquired it, which makes the copy visible.
+	setImageState(image, ResourceAccess::FragmentShaderRead, engine);
+}
+
+void uploadImage(UploadBatch& batch, const void* pixels, VkDeviceSize size, VkImage image, VkFormat format,
+		uint32_t width, uint32_t height, VulkanEngine* engine)
+{
+	StagingAllocation staging = stageUpload(batch, size, 4, engine);
+	memcpy(staging.data, pixels, static_cast<size_t>(size));
+
+	requireImageAccess(batch.copyBarriers, image, colorRange(), ResourceAccess::TransferWrite, engine);
+
+	PendingImageCopy copy{};
+	copy.buffer = staging.buffer;
+	copy.image = image;
+	copy.region.bufferOffset = staging.offset;
+	copy.region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+	copy.region.imageExtent = {width, height, 1};
+	batch.imageCopies.push_back(copy);
+
+	finishImageUpload(batch, image, 1, 1, engine);
+}
+
+uint64_t submitUploadBatch(UploadBatch& batch, VulkanEngine* engine)
+{
+	uint64_t submission = flushBatch(batch, engine);
+	batch = UploadBatch{};
+	return submission;
+}
+
+void runUploadBenchmark(uint32_t bufferCount, VulkanEngine* engine)
+{
+	// Small mesh-sized buffers, alternating between vertices and indices.
+	constexpr VkDeviceSize VERTEX_BYTES = 64 * sizeof(Vertex);
+	constexpr VkDeviceSize INDEX_BYTES = 96 * sizeof(uint32_t);
+	std::vector<uint8_t> contents(std::max(VERTEX_BYTES, INDEX_BYTES), 0x5a);
+
+	const StagingRing& ring = engine->_vk.stagingRing;
+	const uint64_t submissionsBefore = ring.submissions;
+	const uint64_t stallsBefore = ring.stalls;
+	const uint64_t bytesBefore = ring.bytesStaged;
+
+	std::vector<AllocatedBuffer> buffers;
+	buffers.reserve(bufferCount);
+
+	auto start = std::chrono::steady_clock::now();
+	UploadBatch uploads = beginUploadBatch(UploadQueue::Transfer, engine);
+	for (uint32_t i = 0; i < bufferCount; ++i) {
+		const bool vertices = i % 2 == 0;
+		const VkDeviceSize size = vertices ? VERTEX_BYTES : INDEX_BYTES;
+		const VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT
+			| (vertices ? VK_BUFFER_USAGE_VERTEX_BUFFER_BIT : VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+		buffers.push_back(createBuffer(size, usage, 0, engine));
+		uploadBuffer(uploads, contents.data(), size, buffers.back().buffer, 0, engine);
+	}
+	auto recorded = std::chrono::steady_clock::now();
+	uint64_t submission = submitUploadBatch(uploads, engine);
+	waitForUpload(submission, engine);
+	auto finished = std::chrono::steady_clock::now();
+
+	// The frame being recorded still has to acquire the buffers from the transfer family.
+	requireUpload(submission, engine);
+	for (AllocatedBuffer& buffer : buffers) {
+		deferDestroyBuffer(buffer, engine);
+	}
+
+	Logger::Info("Upload benchmark: " + std::to_string(bufferCount) + " buffers, "
+		+ std::to_string((ring.bytesStaged - bytesBefore) / 1024) + " KiB in "
+		+ std::to_string(std::chrono::duration<double, std::milli>(finished - start).count()) + " ms ("
+		+ std::to_string(std::chrono::duration<double, std::milli>(recorded - start).count()) + " ms staging and recording), "
+		+ std::to_string(ring.submissions - submissionsBefore) + " submissions, "
+		+ std::to_string(ring.stalls - stallsBefore) + " ring stalls");
+}
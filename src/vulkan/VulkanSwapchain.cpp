@@ -3,11 +3,15 @@
 #include "vulkan/VulkanImage.hpp"
 #include "vulkan/VulkanSync.hpp"
 #include "vulkan/VulkanRenderPass.hpp"
+#include "vulkan/VulkanDeletionQueue.hpp"
+#include "vulkan/VulkanTransient.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanCommandBuffer.hpp"
 #include "vulkan/VulkanEngine.hpp"
 #include <stdexcept>
 #include <algorithm>
 
-void createSwapchain(VulkanEngine* engine)
+void createSwapchain(VulkanEngine* engine, VkSwapchainKHR oldSwapchain)
 {
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(engine, engine->_vk.physicalDevice);
 
@@ -46,7 +50,7 @@ void createSwapchain(VulkanEngine* engine)
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = oldSwapchain;
 
 	if (vkCreateSwapchainKHR(engine->_vk.device, &createInfo, nullptr, &engine->_vk.swapchain) != VK_SUCCESS) {
 		throw std::runtime_error("Could not create swapchain!");
@@ -70,14 +74,33 @@ void recreateSwapchain(VulkanEngine* engine)
 		glfwWaitEvents();
 	}
 
-	vkDeviceWaitIdle(engine->_vk.device);
+	// Frames still in flight may reference the old swapchain objects; retire them
+	// through the deletion queue instead of idling the device.
+	for (VkFramebuffer& framebuffer : engine->_vk.swapchainFramebuffers) {
+		deferDestroyFramebuffer(framebuffer, engine);
+	}
+	for (VkImageView& imageView : engine->_vk.swapchainImageViews) {
+		deferDestroyImageView(imageView, engine);
+	}
+	for (VkSemaphore& semaphore : engine->_vk.renderFinishedSemaphores) {
+		deferDestroySemaphore(semaphore, engine);
+	}
+	releaseTransientImages(engine);
+	// New swapchain images may reuse the handles.
+	for (VkImage image : engine->_vk.swapchainImages) {
+		forgetImage(image, engine);
+	}
+
+	VkSwapchainKHR oldSwapchain = engine->_vk.swapchain;
+	createSwapchain(engine, oldSwapchain);
+	deferDestroy([engine, oldSwapchain]() { vkDestroySwapchainKHR(engine->_vk.device, oldSwapchain, nullptr); }, engine);
 
-	cleanupSwapchain(engine);
-	cleanupSyncObjects(engine);
-	createSwapchain(engine);
 	createImageViews(engine);
+	buildTransientImages(engine);
 	createFramebuffers(engine);
-	createSyncObjects(engine);
+	createSwapchainSemaphores(engine);
+	// Viewport and scissor are baked into the cached scene commands.
+	invalidateSceneCommands(engine);
 }
 
 void cleanupSwapchain(VulkanEngine* engine)
@@ -1,42 +1,126 @@
 #include "vulkan/VulkanSync.hpp"
 
-void createSyncObjects(VulkanEngine* engine)
+namespace {
+
+	VkSemaphore createTimelineSemaphore(VulkanEngine* engine)
+	{
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		VkSemaphore semaphore;
+		if (vkCreateSemaphore(engine->_vk.device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timeline semaphore!");
+		}
+		return semaphore;
+	}
+
+} // namespace
+
+void createQueueTimelines(VulkanEngine* engine)
 {
-	size_t MAX_FRAMES_IN_FLIGHT = engine->_vk.swapchainImages.size();
+	engine->_vk.graphicsTimeline.semaphore = createTimelineSemaphore(engine);
+	engine->_vk.transferTimeline.semaphore = createTimelineSemaphore(engine);
+	engine->_vk.computeTimeline.semaphore = createTimelineSemaphore(engine);
+}
 
+void destroyQueueTimelines(VulkanEngine* engine)
+{
+	vkDestroySemaphore(engine->_vk.device, engine->_vk.graphicsTimeline.semaphore, nullptr);
+	vkDestroySemaphore(engine->_vk.device, engine->_vk.transferTimeline.semaphore, nullptr);
+	vkDestroySemaphore(engine->_vk.device, engine->_vk.computeTimeline.semaphore, nullptr);
+	engine->_vk.graphicsTimeline = QueueTimeline{};
+	engine->_vk.transferTimeline = QueueTimeline{};
+	engine->_vk.computeTimeline = QueueTimeline{};
+}
+
+void createSyncObjects(VulkanEngine* engine)
+{
 	engine->_vk.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	engine->_vk.renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	engine->_vk.inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-	engine->_vk.imagesInFlight.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
 
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		if (vkCreateSemaphore(engine->_vk.device, &semaphoreInfo, nullptr, &engine->_vk.imageAvailableSemaphores[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(engine->_vk.device, &semaphoreInfo, nullptr, &engine->_vk.renderFinishedSemaphores[i]) != VK_SUCCESS ||
-			vkCreateFence(engine->_vk.device, &fenceInfo, nullptr, &engine->_vk.inFlightFences[i]) != VK_SUCCESS) {
+		if (vkCreateSemaphore(engine->_vk.device, &semaphoreInfo, nullptr, &engine->_vk.imageAvailableSemaphores[i]) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create synchronization objects!");
 		}
 	}
 
+	createSwapchainSemaphores(engine);
+
 	engine->_vk.currentFrame = 0;
 }
 
+void createSwapchainSemaphores(VulkanEngine* engine)
+{
+	// Present waits on these, and an image can be re-acquired before its previous present
+	// has consumed the semaphore, so there is one per swapchain image.
+	size_t imageCount = engine->_vk.swapchainImages.size();
+	engine->_vk.renderFinishedSemaphores.resize(imageCount);
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	for (size_t i = 0; i < imageCount; i++) {
+		if (vkCreateSemaphore(engine->_vk.device, &semaphoreInfo, nullptr, &engine->_vk.renderFinishedSemaphores[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create synchronization objects!");
+		}
+	}
+}
+
 void cleanupSyncObjects(VulkanEngine* engine)
 {
 	for (auto sem : engine->_vk.imageAvailableSemaphores)
 		vkDestroySemaphore(engine->_vk.device, sem, nullptr);
 	for (auto sem : engine->_vk.renderFinishedSemaphores)
 		vkDestroySemaphore(engine->_vk.device, sem, nullptr);
-	for (auto fence : engine->_vk.inFlightFences)
-		vkDestroyFence(engine->_vk.device, fence, nullptr);
 	engine->_vk.imageAvailableSemaphores.clear();
 	engine->_vk.renderFinishedSemaphores.clear();
-	engine->_vk.inFlightFences.clear();
-	engine->_vk.imagesInFlight.clear();
+}
+
+uint64_t nextTimelineValue(QueueTimeline& timeline)
+{
+	return ++timeline.value;
+}
+
+void waitForFrameSlot(VulkanEngine* engine)
+{
+	uint64_t value = engine->_vk.frameTimelineValues[engine->_vk.currentFrame];
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &engine->_vk.graphicsTimeline.semaphore;
+	waitInfo.pValues = &value;
+	vkWaitSemaphores(engine->_vk.device, &waitInfo, UINT64_MAX);
+}
+
+uint64_t beginFrameSubmission(VulkanEngine* engine)
+{
+	uint64_t value = nextTimelineValue(engine->_vk.graphicsTimeline);
+	engine->_vk.frameTimelineValues[engine->_vk.currentFrame] = value;
+	engine->_vk.frameNumber++;
+	return value;
+}
+
+uint64_t getCompletedFrame(VulkanEngine* engine)
+{
+	VulkanContext& vk = engine->_vk;
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(vk.device, vk.graphicsTimeline.semaphore, &completed);
+
+	// Only the last MAX_FRAMES_IN_FLIGHT frames can still be running; frame N used slot (N - 1) % MAX_FRAMES_IN_FLIGHT.
+	for (uint64_t frame = vk.frameNumber; frame > vk.completedFrame; --frame) {
+		if (vk.frameNumber - frame >= MAX_FRAMES_IN_FLIGHT || vk.frameTimelineValues[(frame - 1) % MAX_FRAMES_IN_FLIGHT] <= completed) {
+			vk.completedFrame = frame;
+			break;
+		}
+	}
+	return vk.completedFrame;
 }
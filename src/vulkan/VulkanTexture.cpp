@@ -5,7 +5,17 @@
 #include <stb_image.h>
 #include "vulkan/VulkanBuffer.hpp"
 #include "vulkan/VulkanImage.hpp"
+#include "vulkan/VulkanTexture.hpp"
+#include "vulkan/VulkanTextureAtlas.hpp"
+#include "vulkan/VulkanSampler.hpp"
+#include "vulkan/VulkanStaging.hpp"
+#include "vulkan/VulkanDefrag.hpp"
+#include "vulkan/VulkanDeletionQueue.hpp"
+#include "Assets/GltfLoader.hpp"
+#include "Logger.hpp"
 
+#include <bit>
+#include <cstring>
 #include <stdexcept>
 #include <filesystem>
 #include <iostream>
@@ -32,102 +42,314 @@ VkImageView createImageView(VkImage image, VkFormat format, VulkanEngine *engine
 	return imageView;
 }
 
-void createTextureImage(std::filesystem::path imagePath, VulkanEngine *engine)
+namespace {
+
+	// Records the upload of tightly packed texels into a new device-local, shader-readable image.
+	void uploadTextureImage(const void* pixels, uint32_t width, uint32_t height, VkFormat format,
+			TextureHandle handle, UploadBatch& uploads, VulkanEngine *engine)
+	{
+		VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * 4;
+		TextureCacheEntry& entry = engine->_vk.textureCache.entries[handle];
+
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		entry.image.image = createImage(width, height, 1, 1,
+			format,
+			VK_IMAGE_TILING_OPTIMAL,
+			usage,
+			engine
+		);
+		VkImage image = entry.image.image.image;
+
+		// Looked up by handle since the entry vector may have grown by the time the image moves.
+		registerMovableImage(entry.image.image, width, height, 1, 1, format, usage,
+			[engine, handle, format](VkImage movedImage) {
+				Scene::Image& image = engine->_vk.textureCache.entries[handle].image;
+				VkImageView oldView = image.view;
+				deferUntilDefragPassEnds([engine, oldView]() { vkDestroyImageView(engine->_vk.device, oldView, nullptr); }, engine);
+
+				image.image.image = movedImage;
+				image.view = createImageView(movedImage, format, engine);
+				if (handle == engine->_vk.texture) {
+					engine->_vk.textureImageView = image.view;
+					engine->_vk.descriptorSetsDirty = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+				}
+			}, engine);
+
+		uploadImage(uploads, pixels, imageSize, image, format, width, height, engine);
+
+		entry.image.mipLevels = 1;
+		entry.image.view = createImageView(image, format, engine);
+	}
+
+	void destroyTextureEntry(TextureCacheEntry& entry, VulkanEngine *engine)
+	{
+		vkDestroyImageView(engine->_vk.device, entry.image.view, nullptr);
+		destroyImage(entry.image.image, engine);
+		entry = TextureCacheEntry{};
+	}
+
+} // namespace
+
+void createTextureImage(std::filesystem::path imagePath, UploadBatch& uploads, VulkanEngine *engine)
 {
 	int texWidth, texHeight, texChannels;
 	stbi_uc* pixels = stbi_load(imagePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
 
 	if (!pixels) {
 		throw std::runtime_error("Failed to load texture image!");
 	}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	createBuffer(imageSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer,
-		stagingBufferMemory,
-		engine
+	engine->_vk.texture = acquireTexture(imagePath.filename().string(), pixels,
+			static_cast<uint32_t>(texWidth),
+			static_cast<uint32_t>(texHeight),
+			VK_FORMAT_R8G8B8A8_SRGB,
+			uploads,
+			engine
 	);
 
-	void* data;
-	vkMapMemory(engine->_vk.device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(engine->_vk.device, stagingBufferMemory);
-
 	stbi_image_free(pixels);
+}
 
-	createImage(texWidth, texHeight,
-		VK_FORMAT_R8G8B8A8_SRGB,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		engine->_vk.textureImage,
-		engine->_vk.textureImageMemory,
-		engine
-	);
+void createTextureImageView(VulkanEngine *engine)
+{
+	engine->_vk.textureImageView = getTexture(engine->_vk.texture, engine).view;
+}
 
-	transitionImageLayout(engine->_vk.textureImage,
-			VK_FORMAT_R8G8B8A8_SRGB,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			engine
-	);
+void createModelTextures(const Assets::GltfModel& model, UploadBatch& uploads, VulkanEngine *engine)
+{
+	const fastgltf::Asset& asset = model.GetGltfAsset();
+	const std::vector<Assets::DecodedImage>& images = model.GetImages();
 
-	copyBufferToImage(stagingBuffer, engine->_vk.textureImage,
-			static_cast<uint32_t>(texWidth),
-			static_cast<uint32_t>(texHeight),
-			engine
-	);
+	// Color data is stored as sRGB, everything else (normals, metallic/roughness, occlusion) is linear.
+	std::vector<bool> srgbImages(images.size(), false);
+	auto markSrgb = [&](const auto& textureInfo) {
+		if (textureInfo.has_value()) {
+			const auto& texture = asset.textures[textureInfo->textureIndex];
+			if (texture.imageIndex.has_value()) {
+				srgbImages[*texture.imageIndex] = true;
+			}
+		}
+	};
+	for (const auto& material : asset.materials) {
+		markSrgb(material.pbrData.baseColorTexture);
+		markSrgb(material.emissiveTexture);
+	}
 
-	transitionImageLayout(engine->_vk.textureImage,
-			VK_FORMAT_R8G8B8A8_SRGB,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			engine
-	);
+	// createModelSamplers appends the glTF default sampler after the asset's own samplers.
+	const size_t defaultSampler = asset.samplers.size();
+
+	// An image goes into an atlas only if textures use it and all of them sample it in a way the atlas supports.
+	std::vector<bool> referencedImages(images.size(), false);
+	std::vector<bool> atlasImages(images.size(), true);
+	for (const auto& gltfTexture : asset.textures) {
+		if (gltfTexture.imageIndex.has_value()) {
+			size_t imageIndex = *gltfTexture.imageIndex;
+			if (images[imageIndex].pixels.empty()) {
+				continue;
+			}
+			const Scene::Sampler& sampler = engine->_vk.sceneSamplers[gltfTexture.samplerIndex.value_or(defaultSampler)];
+			referencedImages[imageIndex] = true;
+			if (!isAtlasCandidate(images[imageIndex].width, images[imageIndex].height, sampler)) {
+				atlasImages[imageIndex] = false;
+			}
+		}
+	}
+
+	// Upload each image once; textures sharing an image share its handle or atlas region.
+	TextureAtlasBuilder atlasBuilder;
+	std::vector<TextureHandle> imageHandles(images.size(), INVALID_TEXTURE_HANDLE);
+	std::vector<std::optional<uint32_t>> imageRegions(images.size());
+	for (size_t i = 0; i < images.size(); i++) {
+		const Assets::DecodedImage& image = images[i];
+		// DecodeImages already warned about images it could not decode.
+		if (image.pixels.empty()) {
+			continue;
+		}
+		VkFormat format = srgbImages[i] ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		if (referencedImages[i] && atlasImages[i]) {
+			imageRegions[i] = addAtlasTexture(atlasBuilder, image.name, image.pixels.data(), image.width, image.height, format);
+		} else {
+			imageHandles[i] = acquireTexture(image.name, image.pixels.data(), image.width, image.height, format, uploads, engine);
+		}
+	}
+
+	std::vector<AtlasRegion> regions = buildTextureAtlases(atlasBuilder, uploads, engine);
+
+	std::vector<bool> imageClaimed(images.size(), false);
+	for (const auto& gltfTexture : asset.textures) {
+		Scene::Texture texture{};
+		texture.name = gltfTexture.name;
+		texture.sampler = gltfTexture.samplerIndex.value_or(defaultSampler);
+
+		if (!gltfTexture.imageIndex.has_value() || images[*gltfTexture.imageIndex].pixels.empty()) {
+			Logger::Warn("Texture '" + texture.name + "' has no supported image source, skipping");
+			texture.image = INVALID_TEXTURE_HANDLE;
+			engine->_vk.sceneTextures.push_back(texture);
+			continue;
+		}
+
+		size_t imageIndex = *gltfTexture.imageIndex;
+		if (imageRegions[imageIndex].has_value()) {
+			const AtlasRegion& region = regions[*imageRegions[imageIndex]];
+			texture.image = region.atlas;
+			texture.atlasLayer = region.layer;
+			texture.uvOffset = region.uvOffset;
+			texture.uvScale = region.uvScale;
+		} else {
+			texture.image = imageHandles[imageIndex];
+			if (imageClaimed[imageIndex]) {
+				retainTexture(imageHandles[imageIndex], engine);
+			}
+			imageClaimed[imageIndex] = true;
+		}
+		engine->_vk.sceneTextures.push_back(texture);
+	}
 
-	vkDestroyBuffer(engine->_vk.device, stagingBuffer, nullptr);
-	vkFreeMemory(engine->_vk.device, stagingBufferMemory, nullptr);
+	// Images no texture refers to are not kept alive.
+	for (size_t i = 0; i < images.size(); i++) {
+		if (imageHandles[i] != INVALID_TEXTURE_HANDLE && !imageClaimed[i]) {
+			releaseTexture(imageHandles[i], engine);
+		}
+	}
 }
 
-void createTextureImageView(VulkanEngine *engine)
+void destroyModelTextures(VulkanEngine *engine)
 {
-	engine->_vk.textureImageView = createImageView(engine->_vk.textureImage, VK_FORMAT_R8G8B8A8_SRGB, engine);
+	for (const Scene::Texture& texture : engine->_vk.sceneTextures) {
+		if (!texture.atlasLayer.has_value() && texture.image != INVALID_TEXTURE_HANDLE) {
+			releaseTexture(static_cast<TextureHandle>(texture.image), engine);
+		}
+	}
+	engine->_vk.sceneTextures.clear();
 }
 
+uint64_t hashTextureContent(const void* data, size_t size, uint64_t seed)
+{
+	// Word-at-a-time multiply/rotate mix with a splitmix64 finalizer; fast enough to run over every upload.
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = (0x9E3779B97F4A7C15ull + seed) ^ size;
 
-void createTextureSampler(VulkanEngine *engine)
+	size_t offset = 0;
+	for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, bytes + offset, sizeof(word));
+		word = (word ^ seed) * 0xBF58476D1CE4E5B9ull;
+		word ^= word >> 31;
+		hash = std::rotl(hash ^ word, 27) * 0x94D049BB133111EBull;
+	}
+
+	uint64_t tail = 0;
+	memcpy(&tail, bytes + offset, size - offset);
+	hash ^= (tail ^ seed) * 0xBF58476D1CE4E5B9ull;
+
+	hash ^= hash >> 30;
+	hash *= 0xBF58476D1CE4E5B9ull;
+	hash ^= hash >> 27;
+	hash *= 0x94D049BB133111EBull;
+	hash ^= hash >> 31;
+	return hash;
+}
+
+TextureHandle acquireTexture(const std::string& name, const void* pixels, uint32_t width, uint32_t height, VkFormat format,
+		UploadBatch& uploads, VulkanEngine *engine)
 {
-	VkSamplerCreateInfo samplerInfo{};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	TextureCache& cache = engine->_vk.textureCache;
 
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	TextureKey key{};
+	const size_t size = static_cast<size_t>(width) * height * 4;
+	// Two independently seeded passes; see TextureKey.
+	key.contentHash = {hashTextureContent(pixels, size), hashTextureContent(pixels, size, 0xD6E8FEB86659FD93ull)};
+	key.width = width;
+	key.height = height;
+	key.format = format;
+	key.mipLevels = 1;
+
+	if (auto it = cache.lookup.find(key); it != cache.lookup.end()) {
+		cache.entries[it->second].refCount++;
+		cache.hits++;
+		return it->second;
+	}
+
+	TextureHandle handle;
+	if (!cache.freeHandles.empty()) {
+		handle = cache.freeHandles.back();
+		cache.freeHandles.pop_back();
+	} else {
+		handle = static_cast<TextureHandle>(cache.entries.size());
+		cache.entries.emplace_back();
+	}
+
+	TextureCacheEntry& entry = cache.entries[handle];
+	entry.key = key;
+	entry.image.name = name;
+	entry.refCount = 1;
+	uploadTextureImage(pixels, width, height, format, handle, uploads, engine);
+
+	cache.lookup.emplace(key, handle);
+	cache.misses++;
+	return handle;
+}
+
+const Scene::Image& getTexture(TextureHandle handle, VulkanEngine *engine)
+{
+	return engine->_vk.textureCache.entries.at(handle).image;
+}
+
+void retainTexture(TextureHandle handle, VulkanEngine *engine)
+{
+	engine->_vk.textureCache.entries.at(handle).refCount++;
+}
+
+void releaseTexture(TextureHandle handle, VulkanEngine *engine)
+{
+	TextureCache& cache = engine->_vk.textureCache;
+	TextureCacheEntry& entry = cache.entries.at(handle);
+	if (entry.refCount == 0) {
+		throw std::logic_error("Texture released more often than acquired!");
+	}
+
+	if (--entry.refCount > 0) {
+		return;
+	}
+
+	// Frames in flight may still sample the image. The entry keeps owning it until then so a
+	// defragmentation move still finds its current handles.
+	cache.lookup.erase(entry.key);
+	deferDestroy([engine, handle]() {
+		TextureCache& cache = engine->_vk.textureCache;
+		destroyTextureEntry(cache.entries[handle], engine);
+		cache.freeHandles.push_back(handle);
+	}, engine);
+}
+
+void destroyTextureCache(VulkanEngine *engine)
+{
+	TextureCache& cache = engine->_vk.textureCache;
+	for (auto& entry : cache.entries) {
+		if (entry.refCount > 0) {
+			Logger::Warn("Texture '" + entry.image.name + "' still referenced at shutdown");
+			destroyTextureEntry(entry, engine);
+		}
+	}
+
+	Logger::Info("Texture cache: " + std::to_string(cache.hits) + " hits, " + std::to_string(cache.misses) + " uploads");
+	cache = TextureCache{};
+}
+
+void createTextureSampler(VulkanEngine *engine)
+{
+	VkSamplerCreateInfo samplerInfo = makeSamplerCreateInfo(VK_FILTER_LINEAR,
+			VK_SAMPLER_MIPMAP_MODE_LINEAR,
+			VK_SAMPLER_ADDRESS_MODE_REPEAT
+	);
 
 	VkPhysicalDeviceProperties properties;
 	vkGetPhysicalDeviceProperties(engine->_vk.physicalDevice, &properties);
 
 	samplerInfo.anisotropyEnable = VK_TRUE;
 	samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-	samplerInfo.unnormalizedCoordinates = VK_FALSE;
-
-	samplerInfo.compareEnable = VK_TRUE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.mipLodBias = 0.0f;
-	samplerInfo.minLod = 0.0f;
 	samplerInfo.maxLod = 0.0f;
 
-	if (vkCreateSampler(engine->_vk.device, &samplerInfo, nullptr, &engine->_vk.textureSampler)) {
-		throw std::runtime_error("Failed to create texture sampler!");
-	}
+	// Shared through the sampler cache and baked into the descriptor set layout as an immutable sampler.
+	engine->_vk.textureSampler = getSampler(samplerInfo, engine);
 }
@@ -0,0 +1,235 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanTextureAtlas.hpp"
+#include "vulkan/VulkanBuffer.hpp"
+#include "vulkan/VulkanImage.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanStaging.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+	struct Shelf {
+		uint32_t y;
+		uint32_t height;
+		uint32_t cursorX;
+	};
+
+	struct Layer {
+		std::vector<Shelf> shelves;
+		uint32_t nextY = 0;
+	};
+
+	struct Placement {
+		uint32_t layer;
+		uint32_t x;
+		uint32_t y;
+	};
+
+	// First-fit shelf packing; textures are expected sorted by decreasing height.
+	Placement place(std::vector<Layer>& layers, uint32_t width, uint32_t height)
+	{
+		for (uint32_t layerIndex = 0; layerIndex < layers.size(); ++layerIndex) {
+			for (Shelf& shelf : layers[layerIndex].shelves) {
+				if (height <= shelf.height && shelf.cursorX + width <= ATLAS_LAYER_SIZE) {
+					Placement placement{ layerIndex, shelf.cursorX, shelf.y };
+					shelf.cursorX += width;
+					return placement;
+				}
+			}
+		}
+
+		for (uint32_t layerIndex = 0; layerIndex < layers.size(); ++layerIndex) {
+			Layer& layer = layers[layerIndex];
+			if (layer.nextY + height <= ATLAS_LAYER_SIZE) {
+				layer.shelves.push_back({ layer.nextY, height, width });
+				layer.nextY += height;
+				return { layerIndex, 0, layer.shelves.back().y };
+			}
+		}
+
+		Layer& layer = layers.emplace_back();
+		layer.shelves.push_back({ 0, height, width });
+		layer.nextY = height;
+		return { static_cast<uint32_t>(layers.size() - 1), 0, 0 };
+	}
+
+	// Copies the texture into a padded rectangle, replicating its edge texels into the gutter.
+	void writePadded(const PendingAtlasTexture& texture, uint8_t* destination)
+	{
+		uint32_t paddedWidth = texture.width + 2 * ATLAS_PADDING;
+		uint32_t paddedHeight = texture.height + 2 * ATLAS_PADDING;
+
+		for (uint32_t y = 0; y < paddedHeight; ++y) {
+			uint32_t sourceY = std::clamp<int64_t>(static_cast<int64_t>(y) - ATLAS_PADDING, 0, texture.height - 1);
+			for (uint32_t x = 0; x < paddedWidth; ++x) {
+				uint32_t sourceX = std::clamp<int64_t>(static_cast<int64_t>(x) - ATLAS_PADDING, 0, texture.width - 1);
+				memcpy(destination + (static_cast<size_t>(y) * paddedWidth + x) * 4,
+					texture.pixels.data() + (static_cast<size_t>(sourceY) * texture.width + sourceX) * 4, 4);
+			}
+		}
+	}
+
+	void uploadAtlas(TextureAtlas& atlas, const std::vector<const PendingAtlasTexture*>& textures,
+			const std::vector<Placement>& placements, UploadBatch& uploads, VulkanEngine* engine)
+	{
+		VkDeviceSize stagingSize = 0;
+		for (const auto* texture : textures) {
+			stagingSize += static_cast<VkDeviceSize>(texture->width + 2 * ATLAS_PADDING) * (texture->height + 2 * ATLAS_PADDING) * 4;
+		}
+
+		StagingAllocation staging = stageUpload(uploads, stagingSize, 4, engine);
+		uint8_t* data = static_cast<uint8_t*>(staging.data);
+
+		std::vector<VkBufferImageCopy> copies;
+		copies.reserve(textures.size());
+		VkDeviceSize offset = 0;
+
+		for (size_t i = 0; i < textures.size(); ++i) {
+			const PendingAtlasTexture& texture = *textures[i];
+			writePadded(texture, data + offset);
+
+			VkBufferImageCopy copy{};
+			copy.bufferOffset = staging.offset + offset;
+			copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.imageSubresource.mipLevel = 0;
+			copy.imageSubresource.baseArrayLayer = placements[i].layer;
+			copy.imageSubresource.layerCount = 1;
+			copy.imageOffset = { static_cast<int32_t>(placements[i].x), static_cast<int32_t>(placements[i].y), 0 };
+			copy.imageExtent = { texture.width + 2 * ATLAS_PADDING, texture.height + 2 * ATLAS_PADDING, 1 };
+			copies.push_back(copy);
+
+			offset += static_cast<VkDeviceSize>(copy.imageExtent.width) * copy.imageExtent.height * 4;
+		}
+
+		atlas.image = createImage(ATLAS_LAYER_SIZE, ATLAS_LAYER_SIZE, 1, atlas.layerCount,
+			atlas.format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			engine);
+
+		// Copied with the rest of the batch's images behind a single barrier.
+		requireImageAccess(uploads.copyBarriers, atlas.image.image, colorRange(1, atlas.layerCount), ResourceAccess::TransferWrite, engine);
+		for (const VkBufferImageCopy& copy : copies) {
+			uploads.imageCopies.push_back({ staging.buffer, atlas.image.image, copy });
+		}
+
+		finishImageUpload(uploads, atlas.image.image, 1, atlas.layerCount, engine);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = atlas.image.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = atlas.format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = atlas.layerCount;
+
+		if (vkCreateImageView(engine->_vk.device, &viewInfo, nullptr, &atlas.view) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create texture atlas image view!");
+		}
+	}
+
+} // namespace
+
+bool isAtlasCandidate(uint32_t width, uint32_t height, const Scene::Sampler& sampler)
+{
+	auto clamps = [](VkSamplerAddressMode mode) {
+		return mode != VK_SAMPLER_ADDRESS_MODE_REPEAT && mode != VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+	};
+	return width <= ATLAS_MAX_TEXTURE_SIZE && height <= ATLAS_MAX_TEXTURE_SIZE
+		&& clamps(sampler.addressModeU) && clamps(sampler.addressModeV);
+}
+
+uint32_t addAtlasTexture(TextureAtlasBuilder& builder, const std::string& name, const void* pixels,
+		uint32_t width, uint32_t height, VkFormat format)
+{
+	if (width > ATLAS_MAX_TEXTURE_SIZE || height > ATLAS_MAX_TEXTURE_SIZE || width == 0 || height == 0) {
+		throw std::invalid_argument("Texture '" + name + "' is not eligible for atlas packing!");
+	}
+
+	PendingAtlasTexture texture{};
+	texture.name = name;
+	texture.width = width;
+	texture.height = height;
+	texture.format = format;
+	const auto* bytes = static_cast<const uint8_t*>(pixels);
+	texture.pixels.assign(bytes, bytes + static_cast<size_t>(width) * height * 4);
+
+	builder.pending.push_back(std::move(texture));
+	return static_cast<uint32_t>(builder.pending.size() - 1);
+}
+
+std::vector<AtlasRegion> buildTextureAtlases(TextureAtlasBuilder& builder, UploadBatch& uploads, VulkanEngine* engine)
+{
+	std::vector<AtlasRegion> regions(builder.pending.size());
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(engine->_vk.physicalDevice, &properties);
+
+	std::map<VkFormat, std::vector<uint32_t>> groups;
+	for (uint32_t i = 0; i < builder.pending.size(); ++i) {
+		groups[builder.pending[i].format].push_back(i);
+	}
+
+	for (auto& [format, indices] : groups) {
+		std::sort(indices.begin(), indices.end(), [&](uint32_t a, uint32_t b) {
+			const auto& lhs = builder.pending[a];
+			const auto& rhs = builder.pending[b];
+			return lhs.height != rhs.height ? lhs.height > rhs.height : lhs.width > rhs.width;
+		});
+
+		std::vector<Layer> layers;
+		std::vector<Placement> placements;
+		std::vector<const PendingAtlasTexture*> textures;
+		for (uint32_t index : indices) {
+			const PendingAtlasTexture& texture = builder.pending[index];
+			placements.push_back(place(layers, texture.width + 2 * ATLAS_PADDING, texture.height + 2 * ATLAS_PADDING));
+			textures.push_back(&texture);
+		}
+
+		if (layers.size() > properties.limits.maxImageArrayLayers) {
+			throw std::runtime_error("Too many small textures for a single texture atlas!");
+		}
+
+		TextureAtlas atlas{};
+		atlas.format = format;
+		atlas.layerCount = static_cast<uint32_t>(layers.size());
+		atlas.textureCount = static_cast<uint32_t>(textures.size());
+		uploadAtlas(atlas, textures, placements, uploads, engine);
+
+		uint32_t atlasIndex = static_cast<uint32_t>(engine->_vk.textureAtlases.size());
+		engine->_vk.textureAtlases.push_back(atlas);
+
+		for (size_t i = 0; i < indices.size(); ++i) {
+			const PendingAtlasTexture& texture = *textures[i];
+			AtlasRegion& region = regions[indices[i]];
+			region.atlas = atlasIndex;
+			region.layer = placements[i].layer;
+			region.uvOffset = glm::vec2(placements[i].x + ATLAS_PADDING, placements[i].y + ATLAS_PADDING) / float(ATLAS_LAYER_SIZE);
+			region.uvScale = glm::vec2(texture.width, texture.height) / float(ATLAS_LAYER_SIZE);
+		}
+
+		Logger::Info("Packed " + std::to_string(atlas.textureCount) + " small textures into " +
+			std::to_string(atlas.layerCount) + " atlas layer(s) of one image");
+	}
+
+	builder.pending.clear();
+	return regions;
+}
+
+void destroyTextureAtlases(VulkanEngine* engine)
+{
+	for (auto& atlas : engine->_vk.textureAtlases) {
+		vkDestroyImageView(engine->_vk.device, atlas.view, nullptr);
+		destroyImage(atlas.image, engine);
+	}
+	engine->_vk.textureAtlases.clear();
+}
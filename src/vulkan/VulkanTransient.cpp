@@ -0,0 +1,220 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanTransient.hpp"
+#include "vulkan/VulkanDeletionQueue.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+	constexpr double MiB = 1024.0 * 1024.0;
+
+	constexpr VkImageUsageFlags ATTACHMENT_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+	struct AliasGroup {
+		std::vector<uint32_t> members;
+		VkMemoryRequirements requirements{};
+	};
+
+	VkImageCreateInfo makeImageInfo(const TransientImageDesc& desc, VkImageUsageFlags usage, VulkanEngine* engine)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = desc.width ? desc.width : engine->_vk.swapchainExtent.width;
+		imageInfo.extent.height = desc.height ? desc.height : engine->_vk.swapchainExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		return imageInfo;
+	}
+
+	bool overlaps(const TransientImageDesc& a, const TransientImageDesc& b)
+	{
+		return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+	}
+
+	// Lazily allocated memory only ever backs attachments that never leave tile memory.
+	bool createLazyImage(TransientImage& transient, VulkanEngine* engine)
+	{
+		if ((transient.desc.usage & ~ATTACHMENT_USAGE) != 0) {
+			return false;
+		}
+
+		VkImageCreateInfo imageInfo = makeImageInfo(transient.desc, transient.desc.usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, engine);
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+
+		uint32_t memoryType = 0;
+		if (vmaFindMemoryTypeIndexForImageInfo(engine->_vk.allocator, &imageInfo, &allocInfo, &memoryType) != VK_SUCCESS) {
+			return false;
+		}
+
+		return vmaCreateImage(engine->_vk.allocator, &imageInfo, &allocInfo, &transient.image, &transient.lazyAllocation, nullptr) == VK_SUCCESS;
+	}
+
+	// Greedy interval packing: largest images first, each into the first group whose
+	// members are all dead while it is alive and whose memory types it can use.
+	std::vector<AliasGroup> planAliasGroups(const std::vector<TransientImage>& images, const std::vector<uint32_t>& candidates)
+	{
+		std::vector<uint32_t> order = candidates;
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return images[a].requirements.size > images[b].requirements.size;
+		});
+
+		std::vector<AliasGroup> groups;
+		for (uint32_t index : order) {
+			const TransientImage& image = images[index];
+			AliasGroup* target = nullptr;
+			for (AliasGroup& group : groups) {
+				if ((group.requirements.memoryTypeBits & image.requirements.memoryTypeBits) == 0) {
+					continue;
+				}
+				bool disjoint = std::none_of(group.members.begin(), group.members.end(), [&](uint32_t member) {
+					return overlaps(images[member].desc, image.desc);
+				});
+				if (disjoint) {
+					target = &group;
+					break;
+				}
+			}
+
+			if (!target) {
+				target = &groups.emplace_back();
+				target->requirements.memoryTypeBits = image.requirements.memoryTypeBits;
+			}
+			target->members.push_back(index);
+			target->requirements.size = std::max(target->requirements.size, image.requirements.size);
+			target->requirements.alignment = std::max(target->requirements.alignment, image.requirements.alignment);
+			target->requirements.memoryTypeBits &= image.requirements.memoryTypeBits;
+		}
+		return groups;
+	}
+
+} // namespace
+
+TransientImageHandle declareTransientImage(const TransientImageDesc& desc, VulkanEngine* engine)
+{
+	if (desc.firstPass > desc.lastPass) {
+		throw std::runtime_error("Transient image '" + desc.name + "' ends before it starts!");
+	}
+
+	TransientImages& transients = engine->_vk.transientImages;
+	TransientImage& image = transients.images.emplace_back();
+	image.desc = desc;
+	return static_cast<TransientImageHandle>(transients.images.size() - 1);
+}
+
+void buildTransientImages(VulkanEngine* engine)
+{
+	TransientImages& transients = engine->_vk.transientImages;
+	transients.unaliasedBytes = 0;
+	transients.aliasedBytes = 0;
+	transients.lazyImages = 0;
+
+	std::vector<uint32_t> aliasCandidates;
+	for (uint32_t i = 0; i < transients.images.size(); ++i) {
+		TransientImage& transient = transients.images[i];
+		if (createLazyImage(transient, engine)) {
+			transients.lazyImages++;
+		} else {
+			VkImageCreateInfo imageInfo = makeImageInfo(transient.desc, transient.desc.usage, engine);
+			if (vkCreateImage(engine->_vk.device, &imageInfo, nullptr, &transient.image) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create transient image '" + transient.desc.name + "'!");
+			}
+			vkGetImageMemoryRequirements(engine->_vk.device, transient.image, &transient.requirements);
+			transients.unaliasedBytes += transient.requirements.size;
+			aliasCandidates.push_back(i);
+		}
+	}
+
+	for (const AliasGroup& group : planAliasGroups(transients.images, aliasCandidates)) {
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		VmaAllocation allocation;
+		if (vmaAllocateMemory(engine->_vk.allocator, &group.requirements, &allocInfo, &allocation, nullptr) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate transient image memory!");
+		}
+
+		uint32_t groupIndex = static_cast<uint32_t>(transients.allocations.size());
+		transients.allocations.push_back(allocation);
+		transients.aliasedBytes += group.requirements.size;
+
+		for (uint32_t member : group.members) {
+			TransientImage& transient = transients.images[member];
+			transient.aliasGroup = groupIndex;
+			if (vmaBindImageMemory(engine->_vk.allocator, allocation, transient.image) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to bind transient image '" + transient.desc.name + "'!");
+			}
+		}
+	}
+
+	for (TransientImage& transient : transients.images) {
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = transient.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = transient.desc.format;
+		viewInfo.subresourceRange.aspectMask = transient.desc.aspect;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(engine->_vk.device, &viewInfo, nullptr, &transient.view) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create transient image view '" + transient.desc.name + "'!");
+		}
+	}
+
+	Logger::Info("Transient images: " + std::to_string(transients.images.size()) + " (" + std::to_string(transients.lazyImages)
+		+ " lazily allocated), " + std::to_string(transients.aliasedBytes / MiB) + " MiB aliased, "
+		+ std::to_string(transients.unaliasedBytes / MiB) + " MiB without aliasing");
+}
+
+void releaseTransientImages(VulkanEngine* engine)
+{
+	TransientImages& transients = engine->_vk.transientImages;
+	for (TransientImage& transient : transients.images) {
+		deferDestroyImageView(transient.view, engine);
+		VkImage image = transient.image;
+		VmaAllocation lazyAllocation = transient.lazyAllocation;
+		deferDestroy([engine, image, lazyAllocation]() {
+			forgetImage(image, engine);
+			if (lazyAllocation != VK_NULL_HANDLE) {
+				vmaDestroyImage(engine->_vk.allocator, image, lazyAllocation);
+			} else {
+				vkDestroyImage(engine->_vk.device, image, nullptr);
+			}
+		}, engine);
+
+		transient.image = VK_NULL_HANDLE;
+		transient.lazyAllocation = VK_NULL_HANDLE;
+		transient.aliasGroup = UINT32_MAX;
+	}
+
+	// Queued after the images, so the memory outlives everything bound to it.
+	for (VmaAllocation allocation : transients.allocations) {
+		deferDestroy([engine, allocation]() { vmaFreeMemory(engine->_vk.allocator, allocation); }, engine);
+	}
+	transients.allocations.clear();
+}
+
+VkImage getTransientImage(TransientImageHandle handle, VulkanEngine* engine)
+{
+	return engine->_vk.transientImages.images.at(handle).image;
+}
+
+VkImageView getTransientImageView(TransientImageHandle handle, VulkanEngine* engine)
+{
+	return engine->_vk.transientImages.images.at(handle).view;
+}
@@ -0,0 +1,701 @@
+#include "vulkan/VulkanEngine.hpp"
+#include "vulkan/VulkanVirtualTexture.hpp"
+#include "vulkan/VulkanBuffer.hpp"
+#include "vulkan/VulkanImage.hpp"
+#include "vulkan/VulkanBarriers.hpp"
+#include "vulkan/VulkanStaging.hpp"
+#include "vulkan/VulkanSampler.hpp"
+#include "vulkan/VulkanPipeline.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+	struct DirtyRect {
+		uint32_t x0 = UINT32_MAX, y0 = UINT32_MAX, x1 = 0, y1 = 0;
+
+		bool empty() const { return x0 >= x1 || y0 >= y1; }
+	};
+
+	uint32_t levelWidth(const VirtualTexture* texture, uint32_t mip)
+	{
+		return std::max(1u, texture->info.widthInPages >> mip);
+	}
+
+	uint32_t levelHeight(const VirtualTexture* texture, uint32_t mip)
+	{
+		return std::max(1u, texture->info.heightInPages >> mip);
+	}
+
+	void unpackPageId(uint32_t pageId, uint32_t& x, uint32_t& y, uint32_t& mip)
+	{
+		x = pageId & 0x3FFFu;
+		y = (pageId >> 14) & 0x3FFFu;
+		mip = pageId >> 28;
+	}
+
+	uint32_t packPageTableEntry(const VirtualTexture* texture, uint32_t slot, uint32_t mip)
+	{
+		uint32_t physicalX = slot % texture->info.physicalPagesPerSide;
+		uint32_t physicalY = slot / texture->info.physicalPagesPerSide;
+		return physicalX | (physicalY << 8) | (mip << 16) | (1u << 24);
+	}
+
+	// Rewrites the page table entries covered by page (x, y, mip) on every finer level so each
+	// cell points at the finest resident page at or above its own level.
+	void rebakePageTable(VirtualTexture* texture, uint32_t x, uint32_t y, uint32_t mip, std::vector<DirtyRect>& dirty)
+	{
+		for (uint32_t level = 0; level <= mip; ++level) {
+			uint32_t shift = mip - level;
+			uint32_t x0 = x << shift;
+			uint32_t y0 = y << shift;
+			uint32_t x1 = std::min((x + 1) << shift, levelWidth(texture, level));
+			uint32_t y1 = std::min((y + 1) << shift, levelHeight(texture, level));
+
+			for (uint32_t cy = y0; cy < y1; ++cy) {
+				for (uint32_t cx = x0; cx < x1; ++cx) {
+					uint32_t entry = 0;
+					for (uint32_t candidate = level; candidate < texture->mipCount; ++candidate) {
+						uint32_t candidateX = std::min(cx >> (candidate - level), levelWidth(texture, candidate) - 1);
+						uint32_t candidateY = std::min(cy >> (candidate - level), levelHeight(texture, candidate) - 1);
+						int32_t slot = texture->residency[candidate][candidateY * levelWidth(texture, candidate) + candidateX];
+						if (slot >= 0) {
+							entry = packPageTableEntry(texture, static_cast<uint32_t>(slot), candidate);
+							break;
+						}
+					}
+					texture->pageTable[level][cy * levelWidth(texture, level) + cx] = entry;
+				}
+			}
+
+			DirtyRect& rect = dirty[level];
+			rect.x0 = std::min(rect.x0, x0);
+			rect.y0 = std::min(rect.y0, y0);
+			rect.x1 = std::max(rect.x1, x1);
+			rect.y1 = std::max(rect.y1, y1);
+		}
+	}
+
+	std::vector<VirtualTexturePageTableRegion> snapshotDirtyRegions(const VirtualTexture* texture, const std::vector<DirtyRect>& dirty)
+	{
+		std::vector<VirtualTexturePageTableRegion> regions;
+		for (uint32_t level = 0; level < texture->mipCount; ++level) {
+			const DirtyRect& rect = dirty[level];
+			if (rect.empty()) {
+				continue;
+			}
+
+			VirtualTexturePageTableRegion region{};
+			region.mip = level;
+			region.x = rect.x0;
+			region.y = rect.y0;
+			region.width = rect.x1 - rect.x0;
+			region.height = rect.y1 - rect.y0;
+			region.entries.resize(static_cast<size_t>(region.width) * region.height);
+
+			uint32_t stride = levelWidth(texture, level);
+			for (uint32_t row = 0; row < region.height; ++row) {
+				const uint32_t* source = texture->pageTable[level].data() + (region.y + row) * stride + region.x;
+				std::copy(source, source + region.width, region.entries.data() + row * region.width);
+			}
+			regions.push_back(std::move(region));
+		}
+		return regions;
+	}
+
+	VirtualTexturePageLoad loadPage(VirtualTexture* texture, uint32_t slot, uint32_t pageId)
+	{
+		uint32_t x, y, mip;
+		unpackPageId(pageId, x, y, mip);
+
+		VirtualTexturePageLoad load{};
+		load.slot = slot;
+		load.pageId = pageId;
+		load.texels.resize(static_cast<size_t>(texture->tileSize) * texture->tileSize * 4);
+		texture->info.provider(x, y, mip, load.texels.data(), texture->tileSize);
+		return load;
+	}
+
+	void resolveRequests(VirtualTexture* texture, std::vector<uint32_t>& requests,
+			std::vector<VirtualTexturePageLoad>& loads, std::vector<DirtyRect>& dirty)
+	{
+		std::sort(requests.begin(), requests.end());
+		requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+
+		uint64_t batch = ++texture->requestBatch;
+		std::vector<uint32_t> missing;
+
+		for (uint32_t pageId : requests) {
+			uint32_t x, y, mip;
+			unpackPageId(pageId, x, y, mip);
+			if (mip >= texture->mipCount || x >= levelWidth(texture, mip) || y >= levelHeight(texture, mip)) {
+				continue;
+			}
+
+			int32_t slot = texture->residency[mip][y * levelWidth(texture, mip) + x];
+			if (slot < 0) {
+				missing.push_back(pageId);
+				continue;
+			}
+
+			VirtualTexture::Slot& resident = texture->slots[slot];
+			resident.lastRequestBatch = batch;
+			if (!resident.pinned) {
+				texture->lru.splice(texture->lru.begin(), texture->lru, resident.lruPosition);
+			}
+		}
+
+		// Coarse pages first: they cover the most screen area and become the fallback for finer requests.
+		std::sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return (a >> 28) > (b >> 28); });
+		if (missing.size() > texture->info.maxPageLoadsPerUpdate) {
+			missing.resize(texture->info.maxPageLoadsPerUpdate);
+		}
+
+		for (uint32_t pageId : missing) {
+			uint32_t slot;
+			if (!texture->freeSlots.empty()) {
+				slot = texture->freeSlots.back();
+				texture->freeSlots.pop_back();
+			} else {
+				if (texture->lru.empty()) {
+					break;
+				}
+				slot = texture->lru.back();
+				VirtualTexture::Slot& victim = texture->slots[slot];
+				if (victim.lastRequestBatch == batch) {
+					// Every evictable page is visible this frame; loading more would only thrash.
+					break;
+				}
+
+				uint32_t victimX, victimY, victimMip;
+				unpackPageId(victim.pageId, victimX, victimY, victimMip);
+				texture->residency[victimMip][victimY * levelWidth(texture, victimMip) + victimX] = -1;
+				texture->lru.pop_back();
+				rebakePageTable(texture, victimX, victimY, victimMip, dirty);
+			}
+
+			uint32_t x, y, mip;
+			unpackPageId(pageId, x, y, mip);
+
+			VirtualTexture::Slot& target = texture->slots[slot];
+			target.pageId = pageId;
+			target.lastRequestBatch = batch;
+			texture->lru.push_front(slot);
+			target.lruPosition = texture->lru.begin();
+
+			loads.push_back(loadPage(texture, slot, pageId));
+
+			texture->residency[mip][y * levelWidth(texture, mip) + x] = static_cast<int32_t>(slot);
+			rebakePageTable(texture, x, y, mip, dirty);
+		}
+	}
+
+	void workerLoop(VirtualTexture* texture)
+	{
+		while (true) {
+			std::vector<uint32_t> requests;
+			{
+				std::unique_lock<std::mutex> lock(texture->mutex);
+				texture->wake.wait(lock, [texture] { return texture->stopRequested || !texture->pendingRequests.empty(); });
+				if (texture->stopRequested) {
+					return;
+				}
+				requests.swap(texture->pendingRequests);
+			}
+
+			std::vector<VirtualTexturePageLoad> loads;
+			std::vector<DirtyRect> dirty(texture->mipCount);
+			resolveRequests(texture, requests, loads, dirty);
+
+			if (loads.empty()) {
+				continue;
+			}
+
+			std::vector<VirtualTexturePageTableRegion> regions = snapshotDirtyRegions(texture, dirty);
+
+			std::lock_guard<std::mutex> lock(texture->mutex);
+			for (auto& load : loads) {
+				texture->completedLoads.push_back(std::move(load));
+			}
+			for (auto& region : regions) {
+				texture->completedRegions.push_back(std::move(region));
+			}
+		}
+	}
+
+	// Copies the given tiles and page table regions in a single submission and leaves both
+	// images in SHADER_READ_ONLY_OPTIMAL.
+	void uploadPages(VirtualTexture* texture, const std::vector<VirtualTexturePageLoad>& loads,
+			const std::vector<VirtualTexturePageTableRegion>& regions, VulkanEngine* engine)
+	{
+		VkDeviceSize tileBytes = static_cast<VkDeviceSize>(texture->tileSize) * texture->tileSize * 4;
+		VkDeviceSize stagingSize = tileBytes * loads.size();
+		for (const auto& region : regions) {
+			stagingSize += region.entries.size() * sizeof(uint32_t);
+		}
+
+		// Page updates have to land in the frame order the page table assumes, so they stay on the graphics queue.
+		UploadBatch uploads = beginUploadBatch(UploadQueue::Graphics, engine);
+		StagingAllocation staging = stageUpload(uploads, stagingSize, 4, engine);
+		uint8_t* data = static_cast<uint8_t*>(staging.data);
+
+		std::vector<VkBufferImageCopy> tileCopies;
+		std::vector<VkBufferImageCopy> tableCopies;
+		VkDeviceSize offset = 0;
+
+		for (const auto& load : loads) {
+			memcpy(data + offset, load.texels.data(), static_cast<size_t>(tileBytes));
+
+			VkBufferImageCopy copy{};
+			copy.bufferOffset = staging.offset + offset;
+			copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.imageSubresource.mipLevel = 0;
+			copy.imageSubresource.baseArrayLayer = 0;
+			copy.imageSubresource.layerCount = 1;
+			copy.imageOffset = {
+				static_cast<int32_t>((load.slot % texture->info.physicalPagesPerSide) * texture->tileSize),
+				static_cast<int32_t>((load.slot / texture->info.physicalPagesPerSide) * texture->tileSize),
+				0
+			};
+			copy.imageExtent = { texture->tileSize, texture->tileSize, 1 };
+			tileCopies.push_back(copy);
+
+			offset += tileBytes;
+		}
+
+		for (const auto& region : regions) {
+			size_t bytes = region.entries.size() * sizeof(uint32_t);
+			memcpy(data + offset, region.entries.data(), bytes);
+
+			VkBufferImageCopy copy{};
+			copy.bufferOffset = staging.offset + offset;
+			copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.imageSubresource.mipLevel = region.mip;
+			copy.imageSubresource.baseArrayLayer = 0;
+			copy.imageSubresource.layerCount = 1;
+			copy.imageOffset = { static_cast<int32_t>(region.x), static_cast<int32_t>(region.y), 0 };
+			copy.imageExtent = { region.width, region.height, 1 };
+			tableCopies.push_back(copy);
+
+			offset += bytes;
+		}
+
+		VkCommandBuffer commandBuffer = uploads.commandBuffer;
+
+		VkImageSubresourceRange atlasRange = colorRange();
+		VkImageSubresourceRange pageTableRange = colorRange(texture->mipCount);
+
+		BarrierBatch barriers;
+		requireImageAccess(barriers, texture->atlasImage.image, atlasRange, ResourceAccess::TransferWrite, engine);
+		requireImageAccess(barriers, texture->pageTableImage.image, pageTableRange, ResourceAccess::TransferWrite, engine);
+		flushBarriers(commandBuffer, barriers, engine);
+
+		if (!tileCopies.empty()) {
+			vkCmdCopyBufferToImage(commandBuffer, staging.buffer, texture->atlasImage.image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(tileCopies.size()), tileCopies.data());
+		}
+		if (!tableCopies.empty()) {
+			vkCmdCopyBufferToImage(commandBuffer, staging.buffer, texture->pageTableImage.image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(tableCopies.size()), tableCopies.data());
+		}
+
+		requireImageAccess(barriers, texture->atlasImage.image, atlasRange, ResourceAccess::FragmentShaderRead, engine);
+		requireImageAccess(barriers, texture->pageTableImage.image, pageTableRange, ResourceAccess::FragmentShaderRead, engine);
+		flushBarriers(commandBuffer, barriers, engine);
+
+		submitUploadBatch(uploads, engine);
+	}
+
+	void createDescriptors(VirtualTexture* texture, VulkanEngine* engine)
+	{
+		std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[0].pImmutableSamplers = &texture->pageTableSampler;
+
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[1].pImmutableSamplers = &texture->atlasSampler;
+
+		bindings[2].binding = 2;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[2].descriptorCount = 1;
+		bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[3].binding = 3;
+		bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[3].descriptorCount = 1;
+		bindings[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(engine->_vk.device, &layoutInfo, nullptr, &texture->descriptorSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create virtual texture descriptor set layout!");
+		}
+
+		std::array<VkDescriptorPoolSize, 3> poolSizes{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount = 2 * MAX_FRAMES_IN_FLIGHT;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+		if (vkCreateDescriptorPool(engine->_vk.device, &poolInfo, nullptr, &texture->descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create virtual texture descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, texture->descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = texture->descriptorPool;
+		allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		allocInfo.pSetLayouts = layouts.data();
+
+		texture->descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+		if (vkAllocateDescriptorSets(engine->_vk.device, &allocInfo, texture->descriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate virtual texture descriptor sets!");
+		}
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			VkDescriptorImageInfo pageTableInfo{};
+			pageTableInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			pageTableInfo.imageView = texture->pageTableView;
+			pageTableInfo.sampler = VK_NULL_HANDLE;
+
+			VkDescriptorImageInfo atlasInfo{};
+			atlasInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			atlasInfo.imageView = texture->atlasView;
+			atlasInfo.sampler = VK_NULL_HANDLE;
+
+			VkDescriptorBufferInfo feedbackInfo{};
+			feedbackInfo.buffer = texture->feedbackBuffers[i].buffer;
+			feedbackInfo.offset = 0;
+			feedbackInfo.range = VK_WHOLE_SIZE;
+
+			VkDescriptorBufferInfo paramInfo{};
+			paramInfo.buffer = texture->paramBuffers[i].buffer;
+			paramInfo.offset = 0;
+			paramInfo.range = sizeof(VirtualTextureParams);
+
+			std::array<VkWriteDescriptorSet, 4> writes{};
+			for (uint32_t binding = 0; binding < writes.size(); binding++) {
+				writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[binding].dstSet = texture->descriptorSets[i];
+				writes[binding].dstBinding = binding;
+				writes[binding].dstArrayElement = 0;
+				writes[binding].descriptorCount = 1;
+				writes[binding].descriptorType = bindings[binding].descriptorType;
+			}
+			writes[0].pImageInfo = &pageTableInfo;
+			writes[1].pImageInfo = &atlasInfo;
+			writes[2].pBufferInfo = &feedbackInfo;
+			writes[3].pBufferInfo = &paramInfo;
+
+			vkUpdateDescriptorSets(engine->_vk.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		}
+	}
+
+	void createPipeline(VirtualTexture* texture, VulkanEngine* engine)
+	{
+		static_assert(VIRTUAL_TEXTURE_SET == 1, "The scene's set comes first");
+		std::array<VkDescriptorSetLayout, 2> setLayouts = { engine->_vk.descriptorSetLayout, texture->descriptorSetLayout };
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		layoutInfo.pSetLayouts = setLayouts.data();
+
+		if (vkCreatePipelineLayout(engine->_vk.device, &layoutInfo, nullptr, &texture->pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create virtual texture pipeline layout!");
+		}
+		texture->pipeline = createScenePipeline("../shaders/shader.vert.spv", "../shaders/virtual_texture.frag.spv", false,
+			texture->pipelineLayout, engine);
+	}
+
+} // namespace
+
+uint32_t packVirtualTexturePageId(uint32_t x, uint32_t y, uint32_t mip)
+{
+	return (mip << 28) | ((y & 0x3FFFu) << 14) | (x & 0x3FFFu);
+}
+
+VirtualTexture* createVirtualTexture(const VirtualTextureCreateInfo& createInfo, VulkanEngine* engine)
+{
+	if (!createInfo.provider) {
+		throw std::invalid_argument("Virtual texture requires a page provider!");
+	}
+	if (!std::has_single_bit(createInfo.widthInPages) || !std::has_single_bit(createInfo.heightInPages) ||
+		std::max(createInfo.widthInPages, createInfo.heightInPages) > 0x2000u || createInfo.physicalPagesPerSide > 0xFFu) {
+		throw std::invalid_argument("Unsupported virtual texture dimensions!");
+	}
+
+	auto* texture = new VirtualTexture();
+	texture->info = createInfo;
+	texture->mipCount = std::bit_width(std::max(createInfo.widthInPages, createInfo.heightInPages));
+	texture->tileSize = createInfo.pageSize + 2 * createInfo.pageBorder;
+	texture->atlasSize = createInfo.physicalPagesPerSide * texture->tileSize;
+
+	// --- GPU resources ---
+	texture->pageTableImage = createImage(createInfo.widthInPages, createInfo.heightInPages, texture->mipCount, 1,
+		VK_FORMAT_R8G8B8A8_UINT,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		engine);
+
+	texture->atlasImage = createImage(texture->atlasSize, texture->atlasSize, 1, 1,
+		VK_FORMAT_R8G8B8A8_SRGB,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		engine);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	viewInfo.image = texture->pageTableImage.image;
+	viewInfo.format = VK_FORMAT_R8G8B8A8_UINT;
+	viewInfo.subresourceRange.levelCount = texture->mipCount;
+	if (vkCreateImageView(engine->_vk.device, &viewInfo, nullptr, &texture->pageTableView) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create page table image view!");
+	}
+
+	viewInfo.image = texture->atlasImage.image;
+	viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+	viewInfo.subresourceRange.levelCount = 1;
+	if (vkCreateImageView(engine->_vk.device, &viewInfo, nullptr, &texture->atlasView) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create physical cache image view!");
+	}
+
+	texture->pageTableSampler = getSampler(makeSamplerCreateInfo(VK_FILTER_NEAREST,
+			VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE), engine);
+	texture->atlasSampler = getSampler(makeSamplerCreateInfo(VK_FILTER_LINEAR,
+			VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE), engine);
+
+	VkExtent2D extent = engine->_vk.swapchainExtent;
+	extent.width = std::max(extent.width, SCREEN_WIDTH);
+	extent.height = std::max(extent.height, SCREEN_HEIGHT);
+	texture->feedbackWidth = (extent.width + createInfo.feedbackScale - 1) / createInfo.feedbackScale;
+	texture->feedbackHeight = (extent.height + createInfo.feedbackScale - 1) / createInfo.feedbackScale;
+	VkDeviceSize feedbackSize = static_cast<VkDeviceSize>(texture->feedbackWidth) * texture->feedbackHeight * sizeof(uint32_t);
+
+	texture->feedbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	texture->feedbackMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	texture->paramBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	texture->paramMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		// Read back on the CPU every frame, so ask for cached host memory.
+		texture->feedbackBuffers[i] = createBuffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT, engine);
+		texture->feedbackMapped[i] = static_cast<uint32_t*>(texture->feedbackBuffers[i].allocationInfo.pMappedData);
+		memset(texture->feedbackMapped[i], 0xFF, static_cast<size_t>(feedbackSize));
+
+		texture->paramBuffers[i] = createBuffer(sizeof(VirtualTextureParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, engine);
+		texture->paramMapped[i] = texture->paramBuffers[i].allocationInfo.pMappedData;
+	}
+
+	createDescriptors(texture, engine);
+	createPipeline(texture, engine);
+
+	// --- Residency state ---
+	uint32_t slotCount = createInfo.physicalPagesPerSide * createInfo.physicalPagesPerSide;
+	texture->slots.resize(slotCount);
+	for (uint32_t slot = slotCount; slot-- > 0;) {
+		texture->freeSlots.push_back(slot);
+	}
+
+	texture->residency.resize(texture->mipCount);
+	texture->pageTable.resize(texture->mipCount);
+	for (uint32_t mip = 0; mip < texture->mipCount; ++mip) {
+		size_t cells = static_cast<size_t>(levelWidth(texture, mip)) * levelHeight(texture, mip);
+		texture->residency[mip].assign(cells, -1);
+		texture->pageTable[mip].assign(cells, 0);
+	}
+
+	// The coarsest mip stays resident so every lookup has a fallback page.
+	uint32_t topMip = texture->mipCount - 1;
+	uint32_t topPages = levelWidth(texture, topMip) * levelHeight(texture, topMip);
+	if (topPages > slotCount) {
+		throw std::invalid_argument("Physical cache cannot hold the coarsest virtual texture mip!");
+	}
+
+	std::vector<VirtualTexturePageLoad> loads;
+	std::vector<DirtyRect> dirty(texture->mipCount);
+	for (uint32_t y = 0; y < levelHeight(texture, topMip); ++y) {
+		for (uint32_t x = 0; x < levelWidth(texture, topMip); ++x) {
+			uint32_t slot = texture->freeSlots.back();
+			texture->freeSlots.pop_back();
+			texture->slots[slot].pageId = packVirtualTexturePageId(x, y, topMip);
+			texture->slots[slot].pinned = true;
+			texture->residency[topMip][y * levelWidth(texture, topMip) + x] = static_cast<int32_t>(slot);
+			loads.push_back(loadPage(texture, slot, texture->slots[slot].pageId));
+			rebakePageTable(texture, x, y, topMip, dirty);
+		}
+	}
+
+	uploadPages(texture, loads, snapshotDirtyRegions(texture, dirty), engine);
+
+	texture->worker = std::thread(workerLoop, texture);
+	engine->_vk.virtualTextures.push_back(texture);
+
+	Logger::Info("Created virtual texture '" + createInfo.name + "' (" +
+		std::to_string(createInfo.widthInPages * createInfo.pageSize) + "x" +
+		std::to_string(createInfo.heightInPages * createInfo.pageSize) + " virtual, " +
+		std::to_string(texture->atlasSize) + "x" + std::to_string(texture->atlasSize) + " physical cache)");
+
+	return texture;
+}
+
+void destroyVirtualTexture(VirtualTexture* texture, VulkanEngine* engine)
+{
+	{
+		std::lock_guard<std::mutex> lock(texture->mutex);
+		texture->stopRequested = true;
+	}
+	texture->wake.notify_one();
+	if (texture->worker.joinable()) {
+		texture->worker.join();
+	}
+
+	auto& textures = engine->_vk.virtualTextures;
+	textures.erase(std::remove(textures.begin(), textures.end(), texture), textures.end());
+
+	VkDevice device = engine->_vk.device;
+	for (size_t i = 0; i < texture->feedbackBuffers.size(); i++) {
+		destroyBuffer(texture->feedbackBuffers[i], engine);
+		destroyBuffer(texture->paramBuffers[i], engine);
+	}
+
+	vkDestroyPipeline(device, texture->pipeline, nullptr);
+	vkDestroyPipelineLayout(device, texture->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, texture->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, texture->descriptorSetLayout, nullptr);
+
+	vkDestroyImageView(device, texture->pageTableView, nullptr);
+	destroyImage(texture->pageTableImage, engine);
+
+	vkDestroyImageView(device, texture->atlasView, nullptr);
+	destroyImage(texture->atlasImage, engine);
+
+	delete texture;
+}
+
+void collectVirtualTextureFeedback(VirtualTexture* texture, uint32_t currentFrame, VulkanEngine* engine)
+{
+	uint32_t* feedback = texture->feedbackMapped[currentFrame];
+	size_t count = static_cast<size_t>(texture->feedbackWidth) * texture->feedbackHeight;
+
+	std::vector<uint32_t> requests;
+	for (size_t i = 0; i < count; ++i) {
+		if (feedback[i] != VIRTUAL_TEXTURE_NO_REQUEST) {
+			requests.push_back(feedback[i]);
+		}
+	}
+	memset(feedback, 0xFF, count * sizeof(uint32_t));
+
+	if (!requests.empty()) {
+		{
+			std::lock_guard<std::mutex> lock(texture->mutex);
+			// If the worker fell behind, only the newest frames' requests are worth resolving.
+			if (texture->pendingRequests.size() > count * MAX_FRAMES_IN_FLIGHT) {
+				texture->pendingRequests.clear();
+			}
+			texture->pendingRequests.insert(texture->pendingRequests.end(), requests.begin(), requests.end());
+		}
+		texture->wake.notify_one();
+	}
+
+	// Rotate which texel of each feedbackScale x feedbackScale block writes feedback so all of them are sampled over time.
+	uint32_t scale = texture->info.feedbackScale;
+	texture->frameJitter = (texture->frameJitter + 1) % (scale * scale);
+
+	VirtualTextureParams params{};
+	params.virtualSize = glm::vec4(texture->info.widthInPages, texture->info.heightInPages, texture->info.pageSize, texture->mipCount);
+	params.physicalSize = glm::vec4(texture->tileSize, texture->info.pageBorder, texture->atlasSize, 0.0f);
+	params.feedback = glm::uvec4(
+		std::min(texture->feedbackWidth, (engine->_vk.swapchainExtent.width + scale - 1) / scale),
+		std::min(texture->feedbackHeight, (engine->_vk.swapchainExtent.height + scale - 1) / scale),
+		scale,
+		texture->frameJitter);
+	memcpy(texture->paramMapped[currentFrame], &params, sizeof(params));
+}
+
+void updateVirtualTexture(VirtualTexture* texture, VulkanEngine* engine)
+{
+	std::vector<VirtualTexturePageLoad> loads;
+	std::vector<VirtualTexturePageTableRegion> regions;
+	{
+		std::lock_guard<std::mutex> lock(texture->mutex);
+		loads.swap(texture->completedLoads);
+		regions.swap(texture->completedRegions);
+	}
+
+	if (loads.empty() && regions.empty()) {
+		return;
+	}
+
+	uploadPages(texture, loads, regions, engine);
+}
+
+VirtualTexturePageProvider makeProceduralPageProvider(const VirtualTextureCreateInfo& createInfo)
+{
+	uint32_t pageSize = createInfo.pageSize;
+	uint32_t pageBorder = createInfo.pageBorder;
+	uint32_t width = createInfo.widthInPages * pageSize;
+	uint32_t height = createInfo.heightInPages * pageSize;
+
+	return [=](uint32_t x, uint32_t y, uint32_t mip, uint8_t* texels, uint32_t tileSize) {
+		static constexpr uint8_t mipTints[][3] = {
+			{255, 255, 255}, {255, 200, 200}, {200, 255, 200}, {200, 200, 255},
+			{255, 255, 200}, {255, 200, 255}, {200, 255, 255}, {230, 230, 230},
+		};
+		const uint8_t* tint = mipTints[mip % std::size(mipTints)];
+		int32_t levelWidth = static_cast<int32_t>(std::max(1u, width >> mip));
+		int32_t levelHeight = static_cast<int32_t>(std::max(1u, height >> mip));
+
+		for (uint32_t row = 0; row < tileSize; ++row) {
+			for (uint32_t column = 0; column < tileSize; ++column) {
+				// The border repeats the neighbouring pages' texels, clamped at the texture's edges.
+				int32_t levelX = std::clamp(static_cast<int32_t>(x * pageSize + column) - static_cast<int32_t>(pageBorder), 0, levelWidth - 1);
+				int32_t levelY = std::clamp(static_cast<int32_t>(y * pageSize + row) - static_cast<int32_t>(pageBorder), 0, levelHeight - 1);
+				// Evaluated at the texel's position on mip 0, so every mip shows the same pattern.
+				uint32_t baseX = static_cast<uint32_t>(levelX) << mip;
+				uint32_t baseY = static_cast<uint32_t>(levelY) << mip;
+
+				bool outline = baseX % pageSize < (1u << mip) || baseY % pageSize < (1u << mip);
+				uint8_t value = outline ? 40 : (((baseX / 64) ^ (baseY / 64)) & 1) ? 220 : 120;
+
+				uint8_t* texel = texels + (static_cast<size_t>(row) * tileSize + column) * 4;
+				texel[0] = static_cast<uint8_t>(value * tint[0] / 255);
+				texel[1] = static_cast<uint8_t>(value * tint[1] / 255);
+				texel[2] = static_cast<uint8_t>(value * tint[2] / 255);
+				texel[3] = 255;
+			}
+		}
+	};
+}